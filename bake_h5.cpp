@@ -0,0 +1,24 @@
+#include "hydro_forces.h"
+#include <chrono>
+#include <stdexcept>
+
+// converts an h5 hydro data file into a baked file that H5FileInfo maps
+// without parsing, usage: bake_h5 <input.h5> <output>
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: bake_h5 <input.h5> <output>\n";
+		return 1;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	try {
+		H5FileInfo::Bake(argv[1], argv[2]);
+	}
+	catch (const std::exception& e) {
+		std::cout << e.what() << "\n";
+		return 1;
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	unsigned duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	std::cout << "baked " << argv[1] << " into " << argv[2] << " in " << duration / 1000.0 << " seconds" << std::endl;
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include "checkpoint.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "hydro_forces.h"
+
+namespace {
+	const char kCheckpointMagic[8] = { 'H', 'C', 'C', 'H', 'K', 'P', '0', '1' };
+
+	struct CheckpointHeader {
+		char magic[8];
+		uint32_t num_bodies;
+		uint32_t reserved0;
+		double time;
+		uint64_t payload_bytes;
+		uint64_t checksum;
+		uint32_t reserved[6];
+	};
+
+	static_assert(sizeof(CheckpointHeader) == 64, "checkpoint header must stay 64 bytes");
+
+	/*******************************************************************************
+	* Checksum()
+	* 64 bit FNV-1a hash of data, catches truncated or damaged checkpoints
+	*******************************************************************************/
+	uint64_t Checksum(const char* data, size_t size) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+// =============================================================================
+// CheckpointWriter Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* CheckpointWriter constructor
+* allocates the buffer slots and starts the writer thread
+*******************************************************************************/
+CheckpointWriter::CheckpointWriter() : buffers(kNumBuffers), closing(false) {
+	for (Checkpoint& buffer : buffers) {
+		free_buffers.push_back(&buffer);
+	}
+	writer = std::thread(&CheckpointWriter::WriteCheckpoints, this);
+}
+
+/*******************************************************************************
+* CheckpointWriter destructor
+* writes the queued checkpoints and stops the writer thread
+*******************************************************************************/
+CheckpointWriter::~CheckpointWriter() {
+	{
+		std::lock_guard<std::mutex> lock(buffer_mutex);
+		closing = true;
+		buffer_condition.notify_all();
+	}
+	writer.join();
+}
+
+/*******************************************************************************
+* CheckpointWriter::Save()
+* copies the current state of hydro_forces into a free buffer and queues it
+* to be written to file_name (overwriting it), waiting only if every buffer
+* is still queued. Call it between steps, not from inside a force evaluation
+* returns false if an earlier checkpoint couldn't be written (see GetError()),
+* this one is queued regardless
+*******************************************************************************/
+bool CheckpointWriter::Save(const HydroForces& hydro_forces, std::string file_name) {
+	Checkpoint* checkpoint = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(buffer_mutex);
+		buffer_condition.wait(lock, [this]() { return !free_buffers.empty(); });
+		checkpoint = free_buffers.back();
+		free_buffers.pop_back();
+	}
+	checkpoint->state.Clear();
+	hydro_forces.SaveState(checkpoint->state);
+	checkpoint->file_name = file_name;
+	checkpoint->num_bodies = hydro_forces.GetNumBodies();
+	checkpoint->time = checkpoint->num_bodies > 0 ? hydro_forces.GetBodyState(0).time : 0.0;
+	std::lock_guard<std::mutex> lock(buffer_mutex);
+	full_buffers.push_back(checkpoint);
+	buffer_condition.notify_all();
+	return write_error.empty();
+}
+
+/*******************************************************************************
+* CheckpointWriter::WriteCheckpoints()
+* writer thread, writes queued checkpoints in order until destruction
+*******************************************************************************/
+void CheckpointWriter::WriteCheckpoints() {
+	std::unique_lock<std::mutex> lock(buffer_mutex);
+	while (true) {
+		buffer_condition.wait(lock, [this]() { return !full_buffers.empty() || closing; });
+		if (full_buffers.empty()) {
+			break;
+		}
+		Checkpoint* checkpoint = full_buffers.front();
+		lock.unlock();
+		CheckpointHeader header = {};
+		std::memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+		header.num_bodies = (uint32_t)checkpoint->num_bodies;
+		header.time = checkpoint->time;
+		header.payload_bytes = checkpoint->state.GetSize();
+		header.checksum = Checksum(checkpoint->state.GetData(), checkpoint->state.GetSize());
+		std::string temp_name = checkpoint->file_name + ".tmp";
+		std::ofstream stream(temp_name, std::ios::binary | std::ios::trunc);
+		stream.write((const char*)&header, sizeof(header));
+		stream.write(checkpoint->state.GetData(), checkpoint->state.GetSize());
+		stream.close();
+		std::error_code error;
+		if (!stream.fail()) {
+			std::filesystem::rename(temp_name, checkpoint->file_name, error);
+		}
+		bool failed = stream.fail() || error;
+		lock.lock();
+		if (failed && write_error.empty()) {
+			write_error = "could not write checkpoint " + checkpoint->file_name;
+		}
+		full_buffers.pop_front();
+		free_buffers.push_back(checkpoint);
+		buffer_condition.notify_all();
+	}
+}
+
+/*******************************************************************************
+* CheckpointWriter::Wait()
+* blocks until every queued checkpoint is on disk
+* returns false if any checkpoint so far couldn't be written (see GetError())
+*******************************************************************************/
+bool CheckpointWriter::Wait() {
+	std::unique_lock<std::mutex> lock(buffer_mutex);
+	buffer_condition.wait(lock, [this]() { return (int)free_buffers.size() == kNumBuffers; });
+	return write_error.empty();
+}
+
+/*******************************************************************************
+* CheckpointWriter::GetError()
+* describes the first checkpoint that couldn't be written, empty if none
+*******************************************************************************/
+std::string CheckpointWriter::GetError() {
+	std::lock_guard<std::mutex> lock(buffer_mutex);
+	return write_error;
+}
+
+/*******************************************************************************
+* CheckpointWriter::Load()
+* restores hydro_forces (and with restore_bodies its bodies and the system
+* time) from a checkpoint written by Save() for the same model setup
+* returns false, leaving hydro_forces as it was, if the file can't be read,
+* is damaged or belongs to a different setup, and then says why in *error
+* (if error isn't null)
+*******************************************************************************/
+bool CheckpointWriter::Load(HydroForces& hydro_forces, std::string file_name, bool restore_bodies, std::string* error) {
+	auto fail = [error](std::string message) {
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	};
+	std::ifstream stream(file_name, std::ios::binary);
+	CheckpointHeader header = {};
+	if (!stream.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0) {
+		return fail(file_name + " is not a checkpoint file");
+	}
+	std::vector<char> payload(header.payload_bytes);
+	if (!stream.read(payload.data(), payload.size()) || Checksum(payload.data(), payload.size()) != header.checksum) {
+		return fail(file_name + " is truncated or damaged");
+	}
+	if ((int)header.num_bodies != hydro_forces.GetNumBodies()) {
+		return fail(file_name + " has " + std::to_string(header.num_bodies) + " bodies, the model has " + std::to_string(hydro_forces.GetNumBodies()));
+	}
+	// a checkpoint of a different setup can fail halfway, the current state is put back then
+	StateWriter backup;
+	hydro_forces.SaveState(backup);
+	StateReader reader(payload.data(), payload.size());
+	if (!hydro_forces.RestoreState(reader, restore_bodies)) {
+		StateReader undo(backup.GetData(), backup.GetSize());
+		hydro_forces.RestoreState(undo, false);
+		return fail(file_name + " was saved with different hydro inputs or h5 data, not restored");
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "state_buffer.h"
+
+class HydroForces;
+
+// =============================================================================
+// CheckpointWriter
+// saves the complete hydro state of all bodies (see HydroForces::SaveState())
+// to binary checkpoint files, so a preempted run, or every branch of a what-if
+// study, restarts from it with Load() and continues bit for bit instead of
+// recomputing the warm-up. Save() copies the state into one of kNumBuffers
+// buffers (reused, no allocation once they have grown to the state's size)
+// and returns, a background thread writes it to <file>.tmp and renames that
+// over <file> once complete, so a run killed while writing still leaves the
+// previous checkpoint intact. Save() only waits if every buffer is queued.
+// Nothing is printed, a failed write is reported by the next Save() or Wait()
+// and described by GetError(), a failed Load() describes why in *error.
+// File layout: 64 byte header (magic, number of bodies, time, payload size
+// and checksum), then the payload, native endian.
+// =============================================================================
+class CheckpointWriter {
+public:
+	CheckpointWriter();
+	CheckpointWriter(const CheckpointWriter& other) = delete;
+	CheckpointWriter& operator = (const CheckpointWriter& rhs) = delete;
+	~CheckpointWriter();
+	bool Save(const HydroForces& hydro_forces, std::string file_name);
+	bool Wait();
+	std::string GetError();
+	static bool Load(HydroForces& hydro_forces, std::string file_name, bool restore_bodies = true, std::string* error = nullptr);
+private:
+	static const int kNumBuffers = 2;
+	struct Checkpoint {
+		StateWriter state;
+		std::string file_name;
+		double time;
+		int num_bodies;
+	};
+	void WriteCheckpoints();
+	std::vector<Checkpoint> buffers;
+	std::deque<Checkpoint*> full_buffers;          ///< checkpoints waiting for the writer, in Save() order
+	std::vector<Checkpoint*> free_buffers;
+	std::mutex buffer_mutex;
+	std::condition_variable buffer_condition;
+	bool closing;
+	std::string write_error;                       ///< the first failed write, empty if none
+	std::thread writer;
+};
@@ -0,0 +1,59 @@
+#include "coupling_pattern.h"
+
+#include <algorithm>
+
+// =============================================================================
+// CouplingPattern Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* CouplingPattern default constructor
+* 0 x 0, no entries
+*******************************************************************************/
+CouplingPattern::CouplingPattern() : num_rows(0), num_cols(0), row_start(1, 0) {}
+
+/*******************************************************************************
+* CouplingPattern constructor
+* keeps the entries of values ([row][col][depth], row major) with any nonzero
+* value, row by row in column order. A null values array gives no entries
+*******************************************************************************/
+CouplingPattern::CouplingPattern(int rows, int cols, const double* values, int depth) : CouplingPattern() {
+	num_rows = rows;
+	num_cols = cols;
+	row_start.assign(num_rows + 1, 0);
+	for (int row = 0; row < num_rows; row++) {
+		for (int col = 0; col < num_cols && values != nullptr; col++) {
+			const double* entry = values + ((size_t)row * num_cols + col) * depth;
+			if (std::any_of(entry, entry + depth, [](double val) { return val != 0.0; })) {
+				entry_col.push_back(col);
+				if (depth == 1) {
+					entry_value.push_back(entry[0]);
+				}
+			}
+		}
+		row_start[row + 1] = (int)entry_col.size();
+	}
+}
+
+/*******************************************************************************
+* CouplingPattern::Multiply()
+* y = A x over the nonzero entries, x has num_cols and y num_rows values.
+* Only for patterns built with depth 1
+*******************************************************************************/
+void CouplingPattern::Multiply(const double* x, double* y) const {
+	for (int row = 0; row < num_rows; row++) {
+		double sum = 0.0;
+		for (int entry = row_start[row]; entry < row_start[row + 1]; entry++) {
+			sum += entry_value[entry] * x[entry_col[entry]];
+		}
+		y[row] = sum;
+	}
+}
+
+/*******************************************************************************
+* CouplingPattern::IsNonzero()
+* true if entry (row, col) has any nonzero value, false outside the matrix
+*******************************************************************************/
+bool CouplingPattern::IsNonzero(int row, int col) const {
+	return row < num_rows && std::binary_search(entry_col.begin() + row_start[row], entry_col.begin() + row_start[row + 1], col);
+}
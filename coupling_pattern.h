@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// =============================================================================
+// CouplingPattern
+// the nonzero (row, col) entries of a rows x cols coefficient matrix in
+// compressed row form, found once when the coefficients are loaded. The
+// coefficients are read from a row major [row][col][depth] array, depth > 1
+// for entries that are series over time or frequency (RIRF, excitation): an
+// entry is kept if any of its depth values is nonzero. For depth 1 the entry
+// values are kept as well and Multiply() only visits the nonzero entries.
+// =============================================================================
+class CouplingPattern {
+public:
+	CouplingPattern();
+	CouplingPattern(int rows, int cols, const double* values, int depth = 1);
+	void Multiply(const double* x, double* y) const;
+	bool IsNonzero(int row, int col) const;
+	bool IsRowNonzero(int row) const { return row < num_rows && row_start[row + 1] > row_start[row]; }
+	int GetNumRows() const { return num_rows; }
+	int GetNumCols() const { return num_cols; }
+	int GetNumNonzeros() const { return (int)entry_col.size(); }
+	int GetRowStart(int row) const { return row_start[row]; }
+	int GetCol(int entry) const { return entry_col[entry]; }
+	double GetValue(int entry) const { return entry_value[entry]; }
+	size_t GetNumBytes() const { return sizeof(int) * (row_start.size() + entry_col.size()) + sizeof(double) * entry_value.size(); }
+private:
+	int num_rows;
+	int num_cols;
+	std::vector<int> row_start;        ///< [row], num_rows + 1 values, first entry of each row
+	std::vector<int> entry_col;        ///< [entry], column of each nonzero entry
+	std::vector<double> entry_value;   ///< [entry], only for depth 1
+};
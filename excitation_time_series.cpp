@@ -0,0 +1,212 @@
+#include "excitation_time_series.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	/*******************************************************************************
+	* InverseFFT()
+	* in place radix-2 inverse DFT without the 1/n normalization,
+	* data[n] = sum_m data[m] e^(2 pi i m n / size), size a power of two,
+	* twiddle[k] = e^(2 pi i k / size) for k < size / 2
+	*******************************************************************************/
+	void InverseFFT(std::vector<std::complex<double>>& data, const std::vector<std::complex<double>>& twiddle) {
+		int size = (int)data.size();
+		for (int i = 1, j = 0; i < size; i++) {
+			int bit = size >> 1;
+			for (; j & bit; bit >>= 1) {
+				j ^= bit;
+			}
+			j ^= bit;
+			if (i < j) {
+				std::swap(data[i], data[j]);
+			}
+		}
+		for (int len = 2; len <= size; len <<= 1) {
+			int half = len >> 1;
+			int stride = size / len;
+			for (int start = 0; start < size; start += len) {
+				for (int k = 0; k < half; k++) {
+					std::complex<double> odd = data[start + k + half] * twiddle[(size_t)k * stride];
+					data[start + k + half] = data[start + k] - odd;
+					data[start + k] += odd;
+				}
+			}
+		}
+	}
+}
+
+// =============================================================================
+// ExcitationTimeSeries Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* ExcitationTimeSeries default constructor
+* no samples, Compute() gives zero force
+*******************************************************************************/
+ExcitationTimeSeries::ExcitationTimeSeries()
+	: num_dofs(0), num_samples(0), dt(0), window(nullptr), window_first_row(0), window_num_rows(0) {}
+
+/*******************************************************************************
+* ExcitationTimeSeries::GetNumSamples()
+* smallest power of two number of time_step samples covering duration
+*******************************************************************************/
+int ExcitationTimeSeries::GetNumSamples(double time_step, double duration) {
+	int samples = 2;
+	while (samples * time_step < duration && samples < (1 << 30)) {
+		samples <<= 1;
+	}
+	return samples;
+}
+
+/*******************************************************************************
+* ExcitationTimeSeries constructor
+* bins are the FFT bins m_k of the components (0 < m_k < samples / 2), and
+* coefficients_re/_im their complex force amplitudes per DOF ([dof][component]).
+* samples must be a power of two (see GetNumSamples()). With an empty
+* file_name the series is kept in memory, otherwise it is written to file_name
+* (overwriting it) and read back through a mapped window. A file that can't
+* be created falls back to memory (see IsFileBacked()), one that is written
+* but whose first window can't be mapped throws std::runtime_error
+*******************************************************************************/
+ExcitationTimeSeries::ExcitationTimeSeries(int dofs, double time_step, int samples, const std::vector<int>& bins, const std::vector<double>& coefficients_re, const std::vector<double>& coefficients_im, const std::string& file_name)
+	: ExcitationTimeSeries() {
+	num_dofs = dofs;
+	num_samples = samples;
+	dt = time_step;
+	int num_components = (int)bins.size();
+	int num_rows = num_samples + 1;
+	size_t row_bytes = sizeof(float) * num_dofs;
+
+	float* rows = nullptr;
+	if (!file_name.empty()) {
+		file.reset(new MappedFile());
+		size_t size = kHeaderBytes + row_bytes * num_rows;
+		char* base = file->Create(file_name, size) ? file->Map(0, size) : nullptr;
+		if (base != nullptr) {
+			// header: text tag, number of DOFs, number of samples, time step
+			int64_t counts[2] = { num_dofs, num_samples };
+			std::memset(base, 0, kHeaderBytes);
+			std::strcpy(base, "HydroChrono excitation series");
+			std::memcpy(base + 32, counts, sizeof(counts));
+			std::memcpy(base + 48, &dt, sizeof(double));
+			rows = (float*)(base + kHeaderBytes);
+		}
+		else {
+			// kept in memory instead, IsFileBacked() tells the caller
+			file.reset();
+		}
+	}
+	if (file == nullptr) {
+		// each chunk repeats the next chunk's first row so rows n and n + 1 are adjacent
+		int num_chunks = (num_samples + kChunkSamples - 1) / kChunkSamples;
+		chunks.resize(num_chunks);
+		for (int c = 0; c < num_chunks; c++) {
+			chunks[c].resize((size_t)(std::min(kChunkSamples, num_samples - c * kChunkSamples) + 1) * num_dofs);
+		}
+	}
+
+	const double pi = 3.14159265358979323846;
+	std::vector<std::complex<double>> twiddle(num_samples / 2);
+	for (int k = 0; k < num_samples / 2; k++) {
+		twiddle[k] = std::polar(1.0, 2.0 * pi * k / num_samples);
+	}
+	std::vector<std::complex<double>> spectrum(num_samples);
+	for (int j = 0; j < num_dofs; j++) {
+		std::fill(spectrum.begin(), spectrum.end(), std::complex<double>(0.0, 0.0));
+		bool excited = false;
+		for (int k = 0; k < num_components; k++) {
+			if (bins[k] > 0 && bins[k] < num_samples / 2) {
+				spectrum[bins[k]] += std::complex<double>(coefficients_re[(size_t)j * num_components + k], coefficients_im[(size_t)j * num_components + k]);
+				excited = excited || spectrum[bins[k]] != 0.0;
+			}
+		}
+		// DOFs without excitation stay zero, no transform needed
+		if (excited) {
+			InverseFFT(spectrum, twiddle);
+		}
+		// the real part of the one sided sum is the force, the last row repeats the first
+		for (int n = 0; n < num_rows; n++) {
+			float val = (float)spectrum[n % num_samples].real();
+			if (rows != nullptr) {
+				rows[(size_t)n * num_dofs + j] = val;
+				continue;
+			}
+			if (n < num_samples) {
+				chunks[n / kChunkSamples][(size_t)(n % kChunkSamples) * num_dofs + j] = val;
+			}
+			if (n > 0 && n % kChunkSamples == 0) {
+				chunks[n / kChunkSamples - 1][(size_t)kChunkSamples * num_dofs + j] = val;
+			}
+			else if (n == num_samples) {
+				chunks.back()[(chunks.back().size() - num_dofs) + j] = val;
+			}
+		}
+	}
+	if (file != nullptr) {
+		file->Unmap();
+		GetRow(0);
+	}
+}
+
+/*******************************************************************************
+* ExcitationTimeSeries::GetNumBytes()
+* size of the stored samples
+*******************************************************************************/
+size_t ExcitationTimeSeries::GetNumBytes() const {
+	return sizeof(float) * num_dofs * ((size_t)num_samples + 1);
+}
+
+/*******************************************************************************
+* ExcitationTimeSeries::GetRow()
+* samples of all DOFs at time step n (0 <= n < num_samples), row n + 1 follows
+* directly, both stay valid until the next call. Throws std::runtime_error if
+* the window holding them can't be mapped
+*******************************************************************************/
+const float* ExcitationTimeSeries::GetRow(int n) {
+	if (file == nullptr) {
+		return &chunks[n / kChunkSamples][(size_t)(n % kChunkSamples) * num_dofs];
+	}
+	if (window == nullptr || n < window_first_row || n + 1 >= window_first_row + window_num_rows) {
+		// slide the window so it starts at n's chunk, one extra row keeps n + 1 in view
+		window_first_row = n - n % kChunkSamples;
+		window_num_rows = std::min(kWindowChunks * kChunkSamples + 1, num_samples + 1 - window_first_row);
+		size_t row_bytes = sizeof(float) * num_dofs;
+		window = (const float*)file->Map(kHeaderBytes + row_bytes * window_first_row, row_bytes * window_num_rows);
+		if (window == nullptr) {
+			window_num_rows = 0;
+			throw std::runtime_error("could not map excitation time series window at step " + std::to_string(n));
+		}
+	}
+	return window + (size_t)(n - window_first_row) * num_dofs;
+}
+
+/*******************************************************************************
+* ExcitationTimeSeries::Compute()
+* writes the excitation force at time of every DOF to force[0 .. dofs-1],
+* linearly interpolated between the two stored steps around time. Times past
+* the end of the series wrap around, the series is periodic. Throws what
+* GetRow() throws
+*******************************************************************************/
+void ExcitationTimeSeries::Compute(double time, double* force) {
+	if (num_samples == 0) {
+		std::fill(force, force + num_dofs, 0.0);
+		return;
+	}
+	double steps = time / dt;
+	double whole = floor(steps);
+	double frac = steps - whole;
+	long long n = (long long)whole % num_samples;
+	if (n < 0) {
+		n += num_samples;
+	}
+	const float* row = GetRow((int)n);
+	const float* next = row + num_dofs;
+	for (int j = 0; j < num_dofs; j++) {
+		force[j] = row[j] + frac * ((double)next[j] - row[j]);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// =============================================================================
+// ExcitationTimeSeries
+// excitation force of a sum of wave components whose frequencies are bins of
+// a num_samples point FFT on the simulation time grid (w_k = m_k 2 pi / (num_samples dt)),
+// synthesized once for all DOFs by one inverse FFT per DOF. The series is then
+// exactly periodic with period num_samples * dt, so any time maps back into it.
+// Samples are stored as floats, one row of all DOFs per time step, either in
+// memory in fixed size chunks or in a file that is streamed through a mapped
+// window of kWindowChunks chunks. Compute() is a linear interpolation between
+// two rows, O(1) in the number of components.
+// =============================================================================
+class ExcitationTimeSeries {
+public:
+	ExcitationTimeSeries();
+	ExcitationTimeSeries(int dofs, double time_step, int samples, const std::vector<int>& bins, const std::vector<double>& coefficients_re, const std::vector<double>& coefficients_im, const std::string& file_name = "");
+	ExcitationTimeSeries(ExcitationTimeSeries&& other) = default;
+	ExcitationTimeSeries& operator = (ExcitationTimeSeries&& rhs) = default;
+	void Compute(double time, double* force);
+	int GetNumDofs() const { return num_dofs; }
+	int GetNumSamples() const { return num_samples; }
+	double GetTimeStep() const { return dt; }
+	double GetPeriod() const { return dt * num_samples; }
+	size_t GetNumBytes() const;
+	bool IsFileBacked() const { return file != nullptr; }
+	static int GetNumSamples(double time_step, double duration);
+private:
+	const float* GetRow(int n);
+	static const int kChunkSamples = 4096;
+	static const int kWindowChunks = 16;
+	static const size_t kHeaderBytes = 64;
+	int num_dofs;
+	int num_samples;
+	double dt;
+	std::vector<std::vector<float>> chunks;  ///< in memory storage, [chunk][sample][dof], kChunkSamples + 1 rows each
+	std::unique_ptr<MappedFile> file;        ///< file backed storage, header then [sample][dof], num_samples + 1 rows
+	const float* window;                     ///< mapped rows [window_first_row, window_first_row + window_num_rows)
+	int window_first_row;
+	int window_num_rows;
+};
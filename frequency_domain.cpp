@@ -0,0 +1,219 @@
+#include "frequency_domain.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+// =============================================================================
+// FrequencyDomainSolver Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* FrequencyDomainSolver constructor
+* one H5FileInfo per body, all from the same h5 file. Assembles the 6N x 6N
+* added mass and radiation damping at every frequency of the file (coupled
+* files give every body pair's block, uncoupled files only the diagonal
+* blocks) and the hydrostatic stiffness. Masses start at zero, see SetMass().
+* Frequencies a body's A(w) or B(w) doesn't cover are zero, noted in
+* GetSetupMessages()
+*******************************************************************************/
+FrequencyDomainSolver::FrequencyDomainSolver(std::vector<std::shared_ptr<const H5FileInfo>> h5_file_infos)
+	: file_info(h5_file_infos), wave_heading(0.0) {
+	num_bodies = (int)file_info.size();
+	num_dofs = 6 * num_bodies;
+	mass_matrix.setZero(num_dofs, num_dofs);
+	hydrostatic_stiffness.setZero(num_dofs, num_dofs);
+	mooring_stiffness.setZero(num_dofs, num_dofs);
+	mooring_damping.setZero(num_dofs, num_dofs);
+	pto_stiffness.setZero(num_dofs, num_dofs);
+	pto_damping.setZero(num_dofs, num_dofs);
+	if (num_bodies == 0) {
+		return;
+	}
+	std::ostringstream notes;
+
+	freq_list = file_info[0]->GetFrequencyVector();
+	int num_freqs = (int)freq_list.size();
+	added_mass.assign((size_t)num_freqs * num_dofs * num_dofs, 0.0);
+	radiation_damping.assign((size_t)num_freqs * num_dofs * num_dofs, 0.0);
+	for (int i = 0; i < num_bodies; i++) {
+		// a file without A(w) or B(w) has zero dimensions for it, its entries are empty
+		int file_cols = std::max(file_info[i]->GetAddedMassDims(1), file_info[i]->GetRadiationDampingDims(1));
+		int file_freqs = std::max(file_info[i]->GetAddedMassDims(2), file_info[i]->GetRadiationDampingDims(2));
+		const char* names[2] = { "A(w)", "B(w)" };
+		int coefficient_freqs[2] = { file_info[i]->GetAddedMassDims(2), file_info[i]->GetRadiationDampingDims(2) };
+		for (int n = 0; n < 2; n++) {
+			if (coefficient_freqs[n] == 0) {
+				notes << "body " << i + 1 << " has no " << names[n] << ", it is zero\n";
+			}
+			else if (coefficient_freqs[n] < num_freqs) {
+				notes << "body " << i + 1 << " has " << names[n] << " at " << coefficient_freqs[n] << " of " << num_freqs << " frequencies, the rest are zero\n";
+			}
+		}
+		for (int j = 0; j < num_bodies && file_freqs > 0; j++) {
+			int col = file_cols > 6 ? 6 * (file_info[j]->GetBodyNumber() - 1) : (i == j ? 0 : -1);
+			if (col < 0 || col + 6 > file_cols) {
+				continue;
+			}
+			for (int row = 0; row < 6; row++) {
+				for (int c = 0; c < 6; c++) {
+					auto added_entry = file_info[i]->GetAddedMassEntry(row, col + c);
+					auto damping_entry = file_info[i]->GetRadiationDampingEntry(row, col + c);
+					for (int k = 0; k < std::min(num_freqs, file_freqs); k++) {
+						size_t index = ((size_t)k * num_dofs + 6 * i + row) * num_dofs + 6 * j + c;
+						added_mass[index] = k < added_entry.size() ? added_entry[k] : 0.0;
+						radiation_damping[index] = k < damping_entry.size() ? damping_entry[k] : 0.0;
+					}
+				}
+			}
+		}
+
+		// same linearization as HydroForces::ComputeForceHydrostatics(): -K x plus the buoyancy times the rotation angles
+		double buoyancy = file_info[i]->GetRho() * file_info[i]->GetGravity() * file_info[i]->GetDisplacementVolume();
+		hydrostatic_stiffness.block<6, 6>(6 * i, 6 * i) = file_info[i]->GetHydrostaticStiffnessMatrix();
+		for (int d = 3; d < 6; d++) {
+			hydrostatic_stiffness(6 * i + d, 6 * i + d) -= buoyancy;
+		}
+	}
+	setup_messages = notes.str();
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::SetMass()
+* mass and principal moments of inertia of the b-th body, about its center of
+* gravity (the reference point of the h5 file's coefficients)
+*******************************************************************************/
+void FrequencyDomainSolver::SetMass(int b, double mass, ChVector<> inertia) {
+	for (int d = 0; d < 3; d++) {
+		mass_matrix(6 * b + d, 6 * b + d) = mass;
+		mass_matrix(6 * b + 3 + d, 6 * b + 3 + d) = inertia[d];
+	}
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::AddSpring()
+* linear spring and damper between DOF dof and DOF other_dof (any body, -1
+* for the ground): the force on dof is -stiffness (x_dof - x_other) -
+* damping (v_dof - v_other), with the opposite force on other_dof. DOFs out
+* of range throw std::invalid_argument
+*******************************************************************************/
+void FrequencyDomainSolver::AddSpring(ChMatrixDynamic<double>& stiffness_matrix, ChMatrixDynamic<double>& damping_matrix, int dof, int other_dof,
+	double stiffness, double damping) const {
+	if (dof < 0 || dof >= num_dofs || other_dof >= num_dofs) {
+		throw std::invalid_argument("no DOF " + std::to_string(dof) + " or " + std::to_string(other_dof) + " in " + std::to_string(num_dofs) + " DOFs");
+	}
+	stiffness_matrix(dof, dof) += stiffness;
+	damping_matrix(dof, dof) += damping;
+	if (other_dof >= 0) {
+		stiffness_matrix(other_dof, other_dof) += stiffness;
+		damping_matrix(other_dof, other_dof) += damping;
+		stiffness_matrix(dof, other_dof) -= stiffness;
+		stiffness_matrix(other_dof, dof) -= stiffness;
+		damping_matrix(dof, other_dof) -= damping;
+		damping_matrix(other_dof, dof) -= damping;
+	}
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::AddPTO()
+* linear PTO between DOF dof and DOF other_dof (6 * body + DOF, -1 for the
+* ground), its damping gives the absorbed power
+*******************************************************************************/
+void FrequencyDomainSolver::AddPTO(int dof, int other_dof, double stiffness, double damping) {
+	AddSpring(pto_stiffness, pto_damping, dof, other_dof, stiffness, damping);
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::AddMooring()
+* linear mooring between DOF dof and DOF other_dof (-1 for the ground), its
+* damping doesn't count as absorbed power
+*******************************************************************************/
+void FrequencyDomainSolver::AddMooring(int dof, int other_dof, double stiffness, double damping) {
+	AddSpring(mooring_stiffness, mooring_damping, dof, other_dof, stiffness, damping);
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::ClearPTO()
+* removes all PTOs, for sweeps over the PTO coefficients
+*******************************************************************************/
+void FrequencyDomainSolver::ClearPTO() {
+	pto_stiffness.setZero();
+	pto_damping.setZero();
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::Interpolate()
+* coefficients ([freq][row][col]) at omega, linear between the h5 file's
+* frequencies and clamped to its first and last one
+*******************************************************************************/
+void FrequencyDomainSolver::Interpolate(const std::vector<double>& coefficients, double omega, ChMatrixDynamic<double>& matrix) const {
+	int num_freqs = (int)freq_list.size();
+	int k = (int)(std::upper_bound(freq_list.begin(), freq_list.end(), omega) - freq_list.begin()) - 1;
+	k = std::min(std::max(k, 0), num_freqs - 2);
+	double fraction = std::min(std::max((omega - freq_list[k]) / (freq_list[k + 1] - freq_list[k]), 0.0), 1.0);
+	size_t size = (size_t)num_dofs * num_dofs;
+	const double* lower = &coefficients[k * size];
+	const double* upper = lower + size;
+	for (int row = 0; row < num_dofs; row++) {
+		for (int col = 0; col < num_dofs; col++) {
+			size_t index = (size_t)row * num_dofs + col;
+			matrix(row, col) = lower[index] + fraction * (upper[index] - lower[index]);
+		}
+	}
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::Solve()
+* response at every frequency of the h5 file
+*******************************************************************************/
+FrequencyResponse FrequencyDomainSolver::Solve() const {
+	return Solve(freq_list);
+}
+
+/*******************************************************************************
+* FrequencyDomainSolver::Solve()
+* response amplitudes per m of wave amplitude and absorbed PTO power
+* 0.5 w^2 Re(X^H B_pto X) per m^2 at each of omegas (rad/s). DOFs with no
+* mass, stiffness, damping or coupling at all (e.g. yaw without inertia) are
+* left at zero instead of making the system singular
+*******************************************************************************/
+FrequencyResponse FrequencyDomainSolver::Solve(const std::vector<double>& omegas) const {
+	FrequencyResponse response;
+	response.num_dofs = num_dofs;
+	response.omega = omegas;
+	response.rao.assign(omegas.size() * num_dofs, std::complex<double>(0.0, 0.0));
+	response.power.assign(omegas.size(), 0.0);
+	if (num_dofs == 0 || freq_list.size() < 2) {
+		return response;
+	}
+	ChMatrixDynamic<double> stiffness = hydrostatic_stiffness + mooring_stiffness + pto_stiffness;
+	ChMatrixDynamic<double> damping = mooring_damping + pto_damping;
+	int num_omegas = (int)omegas.size();
+	#pragma omp parallel for schedule(dynamic)
+	for (int f = 0; f < num_omegas; f++) {
+		double omega = omegas[f];
+		ChMatrixDynamic<double> added(num_dofs, num_dofs);
+		ChMatrixDynamic<double> radiation(num_dofs, num_dofs);
+		Interpolate(added_mass, omega, added);
+		Interpolate(radiation_damping, omega, radiation);
+		Eigen::MatrixXcd system(num_dofs, num_dofs);
+		system.real() = -omega * omega * (mass_matrix + added) + stiffness;
+		system.imag() = omega * (radiation + damping);
+		Eigen::VectorXcd excitation(num_dofs);
+		for (int b = 0; b < num_bodies; b++) {
+			for (int row = 0; row < 6; row++) {
+				excitation[6 * b + row] = file_info[b]->GetExcitationInterp(row, omega, wave_heading);
+			}
+		}
+		for (int d = 0; d < num_dofs; d++) {
+			if (system.row(d).isZero(0) && system.col(d).isZero(0)) {
+				system(d, d) = 1.0;
+				excitation[d] = 0.0;
+			}
+		}
+		Eigen::VectorXcd rao = system.partialPivLu().solve(excitation);
+		std::copy(rao.data(), rao.data() + num_dofs, response.rao.begin() + (size_t)f * num_dofs);
+		response.power[f] = 0.5 * omega * omega * (rao.adjoint() * pto_damping.cast<std::complex<double>>() * rao)(0, 0).real();
+	}
+	return response;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hydro_forces.h"
+
+// =============================================================================
+// FrequencyDomainSolver
+// steady state response of the linear model to regular waves, solved directly
+// per frequency instead of integrating in time until the transients are gone.
+// With x(t) = Re(X e^(i w t)) the 6N DOFs of all bodies satisfy
+//   (-w^2 (M + A(w)) + i w (B(w) + B_ext) + K + K_ext) X = F(w)
+// with the body masses M, the h5 file's added mass A(w), radiation damping
+// B(w) and excitation F(w) at the wave heading (linearly interpolated between
+// the file's frequencies), the hydrostatic stiffness K of the time domain
+// model, and the linear PTO and mooring terms K_ext, B_ext added with AddPTO()
+// and AddMooring(). A(w) and B(w) of all bodies are assembled once at
+// construction. Frequencies are independent, Solve() spreads them over OpenMP
+// threads, each is one 6N x 6N complex LU solve.
+// =============================================================================
+struct FrequencyResponse {
+	int num_dofs;
+	std::vector<double> omega;                  ///< [freq], rad/s
+	std::vector<std::complex<double>> rao;      ///< [freq][dof], complex response amplitude per m of wave amplitude
+	std::vector<double> power;                  ///< [freq], mean power absorbed by the PTOs per m^2 of wave amplitude, W/m^2
+	std::complex<double> GetRAO(int freq, int dof) const { return rao[(size_t)freq * num_dofs + dof]; }
+};
+
+class FrequencyDomainSolver {
+public:
+	FrequencyDomainSolver(std::vector<std::shared_ptr<const H5FileInfo>> h5_file_infos);
+	void SetMass(int b, double mass, ChVector<> inertia);
+	void AddPTO(int dof, int other_dof, double stiffness, double damping);
+	void AddMooring(int dof, int other_dof, double stiffness, double damping);
+	void ClearPTO();
+	double SetWaveHeading(double val) {
+		wave_heading = val;
+		return wave_heading;
+	}
+	double GetWaveHeading() const { return wave_heading; }
+	int GetNumDofs() const { return num_dofs; }
+	const std::vector<double>& GetFrequencies() const { return freq_list; }
+	const std::string& GetSetupMessages() const { return setup_messages; }
+	FrequencyResponse Solve() const;
+	FrequencyResponse Solve(const std::vector<double>& omegas) const;
+private:
+	void AddSpring(ChMatrixDynamic<double>& stiffness_matrix, ChMatrixDynamic<double>& damping_matrix, int dof, int other_dof, double stiffness, double damping) const;
+	void Interpolate(const std::vector<double>& coefficients, double omega, ChMatrixDynamic<double>& matrix) const;
+	std::vector<std::shared_ptr<const H5FileInfo>> file_info;  ///< one per body, h5 file order
+	int num_bodies;
+	int num_dofs;
+	double wave_heading;                            ///< degrees
+	std::vector<double> freq_list;                  ///< h5 file frequencies, rad/s
+	std::vector<double> added_mass;                 ///< [freq][row][col], 6N x 6N A(w), scaled by rho
+	std::vector<double> radiation_damping;          ///< [freq][row][col], 6N x 6N B(w), scaled by rho
+	ChMatrixDynamic<double> mass_matrix;            ///< 6N x 6N, body masses and inertias
+	ChMatrixDynamic<double> hydrostatic_stiffness;  ///< 6N x 6N, as in the time domain linear hydrostatics
+	ChMatrixDynamic<double> mooring_stiffness;
+	ChMatrixDynamic<double> mooring_damping;
+	ChMatrixDynamic<double> pto_stiffness;
+	ChMatrixDynamic<double> pto_damping;            ///< also gives the absorbed power
+	std::string setup_messages;                     ///< constructor notes on A(w), B(w) coverage
+};
@@ -1,271 +1,634 @@
 #include "hydro_forces.h"
+#include "frequency_domain.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+// HydroForces instrumentation, only compiled in with HYDROCHRONO_PROFILE (see HydroProfile)
+#ifdef HYDROCHRONO_PROFILE
+namespace {
+	/*******************************************************************************
+	* ProfileTimer
+	* adds the nanoseconds between construction and destruction to total
+	*******************************************************************************/
+	class ProfileTimer {
+	public:
+		ProfileTimer(double& total_ns) : total(total_ns), start(std::chrono::steady_clock::now()) {}
+		~ProfileTimer() { total += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(); }
+	private:
+		double& total;
+		std::chrono::steady_clock::time_point start;
+	};
+}
+#define HYDRO_PROFILE_TIME(total_ns) ProfileTimer profile_timer(total_ns)
+#define HYDRO_PROFILE_COUNT(counter) ((counter)++)
+#else
+#define HYDRO_PROFILE_TIME(total_ns)
+#define HYDRO_PROFILE_COUNT(counter)
+#endif
 
 // =============================================================================
 // H5FileInfo Class Definitions
 // =============================================================================
 
+namespace {
+	/*******************************************************************************
+	* EntryView()
+	* the dims[2] values of row i, column j of a [row][col][step] coefficient
+	* array, without copying. Empty if there is no such entry or no array
+	*******************************************************************************/
+	Eigen::Map<const ChVectorDynamic<double>> EntryView(const double* matrix, const hsize_t* dims, int i, int j) {
+		if (matrix == nullptr || i < 0 || j < 0 || i >= (int)dims[0] || j >= (int)dims[1]) {
+			return Eigen::Map<const ChVectorDynamic<double>>(nullptr, 0);
+		}
+		return Eigen::Map<const ChVectorDynamic<double>>(matrix + dims[2] * (j + dims[1] * i), dims[2]);
+	}
+
+	/*******************************************************************************
+	* H5Mutex()
+	* the HDF5 library is only thread safe when built with --enable-threadsafe,
+	* all HDF5 calls hold this lock so files can be read from any thread
+	*******************************************************************************/
+	std::mutex& H5Mutex() {
+		static std::mutex h5_mutex;
+		return h5_mutex;
+	}
+
+	/*******************************************************************************
+	* H5Cache()
+	* process wide (absolute file name, body name) -> H5FileInfo map used by
+	* H5FileInfo::Load(), guarded by H5CacheMutex()
+	*******************************************************************************/
+	std::map<std::pair<std::string, std::string>, std::shared_ptr<const H5FileInfo>>& H5Cache() {
+		static std::map<std::pair<std::string, std::string>, std::shared_ptr<const H5FileInfo>> cache;
+		return cache;
+	}
+
+	std::mutex& H5CacheMutex() {
+		static std::mutex cache_mutex;
+		return cache_mutex;
+	}
+
+	/*******************************************************************************
+	* ReadDataset()
+	* reads the dimensions of dataset name into dims (max_rank entries, missing
+	* trailing dimensions are set to 1) and, if data isn't null, its values in
+	* row major order into data. Caller holds H5Mutex()
+	*******************************************************************************/
+	void ReadDataset(H5::H5File& file, const std::string& name, hsize_t* dims, int max_rank, std::vector<double>* data) {
+		H5::DataSet dataset = file.openDataSet(name);
+		H5::DataSpace filespace = dataset.getSpace();
+		hsize_t file_dims[3] = { 1, 1, 1 };
+		int rank = filespace.getSimpleExtentDims(file_dims);
+		for (int i = 0; i < max_rank; i++) {
+			dims[i] = i < rank ? file_dims[i] : 1;
+		}
+		if (data != nullptr) {
+			data->resize(file_dims[0] * file_dims[1] * file_dims[2]);
+			H5::DataSpace mspace(rank, file_dims);
+			dataset.read(data->data(), H5::PredType::NATIVE_DOUBLE, mspace, filespace);
+		}
+		dataset.close();
+	}
+}
+
 /*******************************************************************************
 * H5FileInfo::readH5Data()
 * private member function called from constructor
 * reads h5 file data and stores it in member variables for use with other
-* classes and forces
+* classes and forces. The large radiation tensors (RIRF K, B(w) and A(w)) only
+* have their dimensions read here, their values are read on first use. B(w)
+* and A(w) are only used by FrequencyDomainSolver, files without them keep
+* zero dimensions
 *******************************************************************************/
-void H5FileInfo::readH5Data() { // TODO break up this function!
+void H5FileInfo::readH5Data() {
+	std::lock_guard<std::mutex> lock(H5Mutex());
 	// open file with read only access
 	H5::H5File sphereFile(h5_file_name, H5F_ACC_RDONLY);
+	std::vector<double> temp;
+	hsize_t dims[3];
 
 	// Read linear restoring stiffness file info into matrices
-	std::string data_name = bodyNum + "/hydro_coeffs/linear_restoring_stiffness";
-	H5::DataSet dataset = sphereFile.openDataSet(data_name);
-	// Get filespace for rank and dimension
-	H5::DataSpace filespace = dataset.getSpace();
-	// Get number of dimensions in the file dataspace
-	// Get and print the dimension sizes of the file dataspace
-	hsize_t dims[2];    // dataset dimensions
-	int rank = filespace.getSimpleExtentDims(dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspace1(rank, dims);
-	double *temp;
-	temp = new double[dims[0] * dims[1]];
-	// read file info into data_out, a 2d array
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
-	// turn the 2d array into a ChMatrix (Eigen dynamic matrix)
-	lin_matrix.resize(dims[0], dims[1]);
-	for (int i = 0; i < dims[0]; i++) {
-		for (int j = 0; j < dims[1]; j++) {
-			lin_matrix(i, j) = temp[i * dims[1] + j];
-		}
-	}
-	dataset.close();
-	delete[] temp;
-
-	data_name = bodyNum + "/hydro_coeffs/added_mass/inf_freq";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	temp = new double[dims[0] * dims[1]];
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
-	// put into equilibrium chvector
-	inf_added_mass.resize(dims[0], dims[1]);
-	for (int i = 0; i < dims[0]; i++) {
-		for (int j = 0; j < dims[1]; j++) {
-			inf_added_mass(i, j) = temp[i * dims[1] + j];
-		}
-	}
-	dataset.close();
-	delete[] temp;
-
-	// repeat same steps from above to get the cb and cg...reusing some of the previous arrays etc
-	data_name = bodyNum + "/properties/cb";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	temp = new double[dims[0] * dims[1]];
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
-	// put into equilibrium chvector
-	for (int i = 0; i < dims[0]; i++) {
-		cb[i] = temp[i];
-	}
-	dataset.close();
-
-	// repeat finally for cg
-	// TODO add a helper function for the repeated reading things
-	data_name = bodyNum + "/properties/cg";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
-	// put into equilibrium chvector
-	for (int i = 0; i < dims[0]; i++) {
-		cg[i] = temp[i];
-	}
-	dataset.close();
-	delete[] temp;
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/linear_restoring_stiffness", dims, 2, &temp);
+	lin_matrix = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(temp.data(), dims[0], dims[1]);
+
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/added_mass/inf_freq", dims, 2, &temp);
+	inf_added_mass = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(temp.data(), dims[0], dims[1]);
+
+	// equilibrium center of buoyancy and gravity
+	ReadDataset(sphereFile, bodyNum + "/properties/cb", dims, 2, &temp);
+	cb = ChVector<double>(temp[0], temp[1], temp[2]);
+	ReadDataset(sphereFile, bodyNum + "/properties/cg", dims, 2, &temp);
+	cg = ChVector<double>(temp[0], temp[1], temp[2]);
 
 	// read displaced volume for buoyancy force
-	data_name = bodyNum + "/properties/disp_vol";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	temp = new double[dims[0] * dims[1]];
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
+	ReadDataset(sphereFile, bodyNum + "/properties/disp_vol", dims, 2, &temp);
 	disp_vol = temp[0];
-	dataset.close();
-
-	// read rho
-	data_name = "simulation_parameters/rho";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
+
+	// read body number, gives this body's columns in coupled (6 x 6N) coefficients
+	ReadDataset(sphereFile, bodyNum + "/properties/body_number", dims, 2, &temp);
+	body_number = (int)temp[0];
+
+	ReadDataset(sphereFile, "simulation_parameters/rho", dims, 2, &temp);
 	rho = temp[0];
-	dataset.close();
-
-	// read g
-	data_name = "simulation_parameters/g";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
+	ReadDataset(sphereFile, "simulation_parameters/g", dims, 2, &temp);
 	g = temp[0];
-	dataset.close();
-	delete[] temp;
 	lin_matrix *= rho*g; // scale by rho*g
+	inf_added_mass *= rho;
 
 	// read frequencies
-	data_name = "simulation_parameters/w";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(freq_dims);
-	mspace1 = H5::DataSpace(rank, freq_dims);
-	temp = new double[freq_dims[0] * freq_dims[1]];
-	freq_list.resize(freq_dims[0]);
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
-	// put into rirf_time_vector chvector
-	for (int i = 0; i < freq_dims[0]; i++) {
-		freq_list[i] = temp[i];
-	}
-	dataset.close();
-	delete[] temp;
-
-	// read K
-	data_name = bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/K";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	int rank3 = filespace.getSimpleExtentDims(rirf_dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspace3(rank3, rirf_dims);
-	// rirf_dims[0] is number of rows, rirf_dims[1] is number of columns, rirf_dims[2] is number of matrices
-	rirf_matrix = new double[rirf_dims[0] * rirf_dims[1] * rirf_dims[2]];
-	// read file info into data_out, a 2d array
-	dataset.read(rirf_matrix, H5::PredType::NATIVE_DOUBLE, mspace3, filespace);
-	dataset.close();
-
-	// read rirf_time_vector
-	data_name = bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/t";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank = filespace.getSimpleExtentDims(dims);
-	mspace1 = H5::DataSpace(rank, dims);
-	temp = new double[dims[0] * dims[1]];
-	rirf_time_vector.resize(dims[0]);
-	dataset.read(temp, H5::PredType::NATIVE_DOUBLE, mspace1, filespace);
-	// put into rirf_time_vector chvector
-	for (int i = 0; i < dims[0]; i++) {
-		rirf_time_vector[i] = temp[i];
-	}
-	dataset.close();
-	delete[] temp;
-
-	// read B(w)
-	data_name = bodyNum + "/hydro_coeffs/radiation_damping/all";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank3 = filespace.getSimpleExtentDims(radiation_damping_dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspaceB(rank3, radiation_damping_dims);
-	// radiation_damping_dims[0] is number of rows, radiation_damping_dims[1] is number of columns, radiation_damping_dims[2] is number of matrices
-	radiation_damping_matrix = new double[radiation_damping_dims[0] * radiation_damping_dims[1] * radiation_damping_dims[2]];
-	// read file info into data_out, a 2d array
-	dataset.read(radiation_damping_matrix, H5::PredType::NATIVE_DOUBLE, mspaceB, filespace);
-	dataset.close();
-
-	// read excitation force coefficients - magnitude
-	data_name = bodyNum + "/hydro_coeffs/excitation/mag";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank3 = filespace.getSimpleExtentDims(excitation_mag_dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspaceExMag(rank3, excitation_mag_dims);
-	//// excitation_mag_dims[0] is number of rows, excitation_mag_dims[1] is number of columns, excitation_mag_dims[2] is number of matrices
-	excitation_mag_matrix = new double[excitation_mag_dims[0] * excitation_mag_dims[1] * excitation_mag_dims[2]];
-	//// read file info into data_out, a 2d array
-	dataset.read(excitation_mag_matrix, H5::PredType::NATIVE_DOUBLE, mspaceExMag, filespace);
-	dataset.close();
-
-	// read excitation force coefficients - phase
-	data_name = bodyNum + "/hydro_coeffs/excitation/phase";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank3 = filespace.getSimpleExtentDims(excitation_phase_dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspaceExPhase(rank3, excitation_phase_dims);
-	//// excitation_phase_dims[0] is number of rows, excitation_phase_dims[1] is number of columns, excitation_phase_dims[2] is number of matrices
-	excitation_phase_matrix = new double[excitation_phase_dims[0] * excitation_phase_dims[1] * excitation_phase_dims[2]];
-	//// read file info into data_out, a 2d array
-	dataset.read(excitation_phase_matrix, H5::PredType::NATIVE_DOUBLE, mspaceExPhase, filespace);
-	dataset.close();
-
-	// read excitation force coefficients - real
-	data_name = bodyNum + "/hydro_coeffs/excitation/re";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank3 = filespace.getSimpleExtentDims(excitation_re_dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspaceExRe(rank3, excitation_re_dims);
-	//// excitation_phase_dims[0] is number of rows, excitation_phase_dims[1] is number of columns, excitation_phase_dims[2] is number of matrices
-	excitation_re_matrix = new double[excitation_re_dims[0] * excitation_re_dims[1] * excitation_re_dims[2]];
-	//// read file info into data_out, a 2d array
-	dataset.read(excitation_re_matrix, H5::PredType::NATIVE_DOUBLE, mspaceExRe, filespace);
-	dataset.close();
-
-	// read excitation force coefficients - im
-	data_name = bodyNum + "/hydro_coeffs/excitation/im";
-	dataset = sphereFile.openDataSet(data_name);
-	filespace = dataset.getSpace();
-	rank3 = filespace.getSimpleExtentDims(excitation_im_dims);
-	// read file into data_out 2d array
-	H5::DataSpace mspaceExIm(rank3, excitation_im_dims);
-	//// excitation_phase_dims[0] is number of rows, excitation_phase_dims[1] is number of columns, excitation_phase_dims[2] is number of matrices
-	excitation_im_matrix = new double[excitation_im_dims[0] * excitation_im_dims[1] * excitation_im_dims[2]];
-	//// read file info into data_out, a 2d array
-	dataset.read(excitation_im_matrix, H5::PredType::NATIVE_DOUBLE, mspaceExIm, filespace);
-	dataset.close();
+	ReadDataset(sphereFile, "simulation_parameters/w", freq_dims, 2, &freq_list);
+	freq_dims[2] = 1;
+
+	// read wave headings (degrees), the columns of the excitation coefficients
+	ReadDataset(sphereFile, "simulation_parameters/wave_dir", dims, 2, &wave_headings);
+
+	// K, B(w) and A(w) dimensions, [number of rows, number of columns, number of matrices]
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/K", rirf_dims, 3, nullptr);
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/t", dims, 2, &rirf_time_vector);
+	if (H5Lexists(sphereFile.getId(), (bodyNum + "/hydro_coeffs/radiation_damping/all").c_str(), H5P_DEFAULT) > 0) {
+		ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/radiation_damping/all", radiation_damping_dims, 3, nullptr);
+	}
+	if (H5Lexists(sphereFile.getId(), (bodyNum + "/hydro_coeffs/added_mass/all").c_str(), H5P_DEFAULT) > 0) {
+		ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/added_mass/all", added_mass_dims, 3, nullptr);
+	}
+
+	// read excitation force coefficients, [number of rows, number of headings, number of frequencies]
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/excitation/mag", excitation_mag_dims, 3, &excitation_mag_storage);
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/excitation/phase", excitation_phase_dims, 3, &excitation_phase_storage);
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/excitation/re", excitation_re_dims, 3, &excitation_re_storage);
+	ReadDataset(sphereFile, bodyNum + "/hydro_coeffs/excitation/im", excitation_im_dims, 3, &excitation_im_storage);
+	for (std::vector<double>* excitation : { &excitation_mag_storage, &excitation_re_storage, &excitation_im_storage }) {
+		for (double& val : *excitation) {
+			val *= rho * g;
+		}
+	}
+	excitation_mag_matrix = excitation_mag_storage.data();
+	excitation_phase_matrix = excitation_phase_storage.data();
+	excitation_re_matrix = excitation_re_storage.data();
+	excitation_im_matrix = excitation_im_storage.data();
 
 	sphereFile.close();
+	FindCouplingPatterns();
+}
+
+/*******************************************************************************
+* H5FileInfo::LoadRIRF()
+* reads the RIRF K (scaled by rho) and finds its nonzero entries on first
+* call, later calls (from any thread) return at once. Baked files already
+* point rirf_matrix into the mapping
+*******************************************************************************/
+void H5FileInfo::LoadRIRF() const {
+	std::call_once(rirf_loaded, [this]() {
+		if (rirf_matrix == nullptr) {
+			std::lock_guard<std::mutex> lock(H5Mutex());
+			H5::H5File h5File(h5_file_name, H5F_ACC_RDONLY);
+			hsize_t dims[3];
+			ReadDataset(h5File, bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/K", dims, 3, &rirf_storage);
+			h5File.close();
+			for (double& val : rirf_storage) {
+				val *= rho; // scale radiation force by rho
+			}
+			rirf_matrix = rirf_storage.data();
+		}
+		if (rirf_matrix != nullptr) {
+			rirf_pattern = CouplingPattern((int)rirf_dims[0], (int)rirf_dims[1], rirf_matrix, (int)rirf_dims[2]);
+		}
+	});
+}
+
+/*******************************************************************************
+* H5FileInfo::LoadRadiationDamping()
+* reads the radiation damping B(w) (scaled by rho) on first call, later calls
+* return at once. Baked files already point radiation_damping_matrix into the
+* mapping, files without B(w) leave it null
+*******************************************************************************/
+void H5FileInfo::LoadRadiationDamping() const {
+	std::call_once(radiation_damping_loaded, [this]() {
+		if (radiation_damping_matrix != nullptr || baked_file != nullptr || radiation_damping_dims[0] * radiation_damping_dims[1] * radiation_damping_dims[2] == 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(H5Mutex());
+		H5::H5File h5File(h5_file_name, H5F_ACC_RDONLY);
+		hsize_t dims[3];
+		ReadDataset(h5File, bodyNum + "/hydro_coeffs/radiation_damping/all", dims, 3, &radiation_damping_storage);
+		h5File.close();
+		for (double& val : radiation_damping_storage) {
+			val *= rho;
+		}
+		radiation_damping_matrix = radiation_damping_storage.data();
+	});
+}
+
+/*******************************************************************************
+* H5FileInfo::LoadAddedMass()
+* reads the frequency dependent added mass A(w) (scaled by rho) on first call,
+* later calls return at once. Baked files already point added_mass_matrix into
+* the mapping, files without A(w) leave it null
+*******************************************************************************/
+void H5FileInfo::LoadAddedMass() const {
+	std::call_once(added_mass_loaded, [this]() {
+		if (added_mass_matrix != nullptr || baked_file != nullptr || added_mass_dims[0] * added_mass_dims[1] * added_mass_dims[2] == 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(H5Mutex());
+		H5::H5File h5File(h5_file_name, H5F_ACC_RDONLY);
+		hsize_t dims[3];
+		ReadDataset(h5File, bodyNum + "/hydro_coeffs/added_mass/all", dims, 3, &added_mass_storage);
+		h5File.close();
+		for (double& val : added_mass_storage) {
+			val *= rho;
+		}
+		added_mass_matrix = added_mass_storage.data();
+	});
+}
+
+namespace {
+	// baked file layout: header, num_entries entries, then the arrays, each
+	// starting on a kBakedAlignment byte boundary. Arrays are native endian
+	// doubles in row major order, named by their h5 dataset path. Files of
+	// another version or written on a host of the other byte order are refused
+	const char kBakedMagic[8] = { 'H', 'C', 'B', 'A', 'K', 'E', '0', '2' };
+	const size_t kBakedTagSize = 6;                ///< "HCBAKE", shared by every version's magic
+	const uint32_t kBakedVersion = 2;              ///< 2 added the frequency dependent added mass
+	const uint32_t kBakedByteOrder = 0x01020304;  ///< reads back swapped on a host of the other byte order
+	const size_t kBakedAlignment = 64;
+
+	struct BakedHeader {
+		char magic[8];
+		uint32_t num_entries;
+		uint32_t version;    ///< kBakedVersion
+		uint32_t byte_order; ///< kBakedByteOrder as the writing host stores it
+		uint32_t reserved[11];
+	};
+
+	struct BakedEntry {
+		char name[104];
+		uint64_t offset;     ///< from the start of the file
+		uint32_t dims[3];
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(BakedHeader) == 64, "baked header must stay 64 bytes");
+	static_assert(sizeof(BakedEntry) == 128, "baked entry must stay 128 bytes");
+
+	struct BakedArray {
+		std::string name;
+		std::vector<double> values;
+		uint32_t dims[3];
+	};
+
+	/*******************************************************************************
+	* AddBakedArray()
+	* appends a copy of values (row major, dims, missing dims are 1) to arrays
+	*******************************************************************************/
+	void AddBakedArray(std::vector<BakedArray>& arrays, const std::string& name, const double* values, size_t d0, size_t d1 = 1, size_t d2 = 1) {
+		BakedArray arr;
+		arr.name = name;
+		arr.values.assign(values, values + d0 * d1 * d2);
+		arr.dims[0] = (uint32_t)d0;
+		arr.dims[1] = (uint32_t)d1;
+		arr.dims[2] = (uint32_t)d2;
+		arrays.push_back(arr);
+	}
+}
+
+/*******************************************************************************
+* H5FileInfo::IsBakedFile()
+* true if file starts with the baked file tag (see Bake()), of any version
+*******************************************************************************/
+bool H5FileInfo::IsBakedFile(std::string file) {
+	std::ifstream stream(file, std::ios::binary);
+	char magic[8] = {};
+	stream.read(magic, sizeof(magic));
+	return stream.good() && std::memcmp(magic, kBakedMagic, kBakedTagSize) == 0;
 }
 
-H5FileInfo::H5FileInfo() {}
+/*******************************************************************************
+* H5FileInfo::Bake()
+* converts every body of h5_file ("body1", "body2", ...) into one baked file
+* holding the arrays H5FileInfo uses, already scaled by rho and g, so that
+* H5FileInfo(baked_file, body_name) only has to map it. B(w) and A(w) are
+* stored empty for h5 files without them
+* throws std::runtime_error if h5_file has no bodies or baked_file can't be
+* written, and what H5FileInfo throws for an unreadable h5_file
+*******************************************************************************/
+void H5FileInfo::Bake(std::string h5_file, std::string baked_file) {
+	std::vector<std::string> body_names;
+	{
+		std::lock_guard<std::mutex> lock(H5Mutex());
+		H5::H5File h5File(h5_file, H5F_ACC_RDONLY);
+		while (H5Lexists(h5File.getId(), ("body" + std::to_string(body_names.size() + 1)).c_str(), H5P_DEFAULT) > 0) {
+			body_names.push_back("body" + std::to_string(body_names.size() + 1));
+		}
+		h5File.close();
+	}
+	if (body_names.empty()) {
+		throw std::runtime_error("no bodies found in " + h5_file);
+	}
 
-H5FileInfo::~H5FileInfo() {
-	delete[] rirf_matrix;
+	std::vector<BakedArray> arrays;
+	for (const std::string& name : body_names) {
+		H5FileInfo info(h5_file, name);
+		info.LoadRIRF();
+		info.LoadRadiationDamping();
+		info.LoadAddedMass();
+		if (arrays.empty()) {
+			AddBakedArray(arrays, "simulation_parameters/rho", &info.rho, 1);
+			AddBakedArray(arrays, "simulation_parameters/g", &info.g, 1);
+			AddBakedArray(arrays, "simulation_parameters/w", info.freq_list.data(), info.freq_list.size());
+			AddBakedArray(arrays, "simulation_parameters/wave_dir", info.wave_headings.data(), info.wave_headings.size());
+		}
+		Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> row_major = info.lin_matrix;
+		AddBakedArray(arrays, name + "/hydro_coeffs/linear_restoring_stiffness", row_major.data(), row_major.rows(), row_major.cols());
+		row_major = info.inf_added_mass;
+		AddBakedArray(arrays, name + "/hydro_coeffs/added_mass/inf_freq", row_major.data(), row_major.rows(), row_major.cols());
+		AddBakedArray(arrays, name + "/properties/cb", info.cb.eigen().data(), 3);
+		AddBakedArray(arrays, name + "/properties/cg", info.cg.eigen().data(), 3);
+		AddBakedArray(arrays, name + "/properties/disp_vol", &info.disp_vol, 1);
+		double body_number = info.body_number;
+		AddBakedArray(arrays, name + "/properties/body_number", &body_number, 1);
+		AddBakedArray(arrays, name + "/hydro_coeffs/radiation_damping/impulse_response_fun/K", info.rirf_matrix, info.rirf_dims[0], info.rirf_dims[1], info.rirf_dims[2]);
+		AddBakedArray(arrays, name + "/hydro_coeffs/radiation_damping/impulse_response_fun/t", info.rirf_time_vector.data(), info.rirf_time_vector.size());
+		AddBakedArray(arrays, name + "/hydro_coeffs/radiation_damping/all", info.radiation_damping_matrix, info.radiation_damping_dims[0], info.radiation_damping_dims[1], info.radiation_damping_dims[2]);
+		AddBakedArray(arrays, name + "/hydro_coeffs/added_mass/all", info.added_mass_matrix, info.added_mass_dims[0], info.added_mass_dims[1], info.added_mass_dims[2]);
+		AddBakedArray(arrays, name + "/hydro_coeffs/excitation/mag", info.excitation_mag_matrix, info.excitation_mag_dims[0], info.excitation_mag_dims[1], info.excitation_mag_dims[2]);
+		AddBakedArray(arrays, name + "/hydro_coeffs/excitation/phase", info.excitation_phase_matrix, info.excitation_phase_dims[0], info.excitation_phase_dims[1], info.excitation_phase_dims[2]);
+		AddBakedArray(arrays, name + "/hydro_coeffs/excitation/re", info.excitation_re_matrix, info.excitation_re_dims[0], info.excitation_re_dims[1], info.excitation_re_dims[2]);
+		AddBakedArray(arrays, name + "/hydro_coeffs/excitation/im", info.excitation_im_matrix, info.excitation_im_dims[0], info.excitation_im_dims[1], info.excitation_im_dims[2]);
+	}
+
+	BakedHeader header = {};
+	std::memcpy(header.magic, kBakedMagic, sizeof(kBakedMagic));
+	header.num_entries = (uint32_t)arrays.size();
+	header.version = kBakedVersion;
+	header.byte_order = kBakedByteOrder;
+	std::vector<BakedEntry> entries(arrays.size());
+	uint64_t offset = sizeof(BakedHeader) + sizeof(BakedEntry) * arrays.size();
+	for (size_t i = 0; i < arrays.size(); i++) {
+		offset = (offset + kBakedAlignment - 1) / kBakedAlignment * kBakedAlignment;
+		std::memset(&entries[i], 0, sizeof(BakedEntry));
+		std::strncpy(entries[i].name, arrays[i].name.c_str(), sizeof(entries[i].name) - 1);
+		entries[i].offset = offset;
+		std::memcpy(entries[i].dims, arrays[i].dims, sizeof(entries[i].dims));
+		offset += sizeof(double) * arrays[i].values.size();
+	}
+
+	std::ofstream stream(baked_file, std::ios::binary | std::ios::trunc);
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)entries.data(), sizeof(BakedEntry) * entries.size());
+	uint64_t position = sizeof(BakedHeader) + sizeof(BakedEntry) * entries.size();
+	const char padding[kBakedAlignment] = {};
+	for (size_t i = 0; i < arrays.size(); i++) {
+		stream.write(padding, entries[i].offset - position);
+		stream.write((const char*)arrays[i].values.data(), sizeof(double) * arrays[i].values.size());
+		position = entries[i].offset + sizeof(double) * arrays[i].values.size();
+	}
+	if (!stream.good()) {
+		throw std::runtime_error("could not write baked file " + baked_file);
+	}
 }
 
+/*******************************************************************************
+* H5FileInfo::readBakedData()
+* private member function called from constructor for baked files
+* maps the file and points the coefficient arrays straight into it, nothing is
+* parsed or copied apart from the small matrices and vectors
+* throws std::runtime_error if the file can't be mapped, is of another version
+* or byte order, is truncated or damaged, or lacks an array of body_name
+*******************************************************************************/
+void H5FileInfo::readBakedData() {
+	auto fail = [this](const std::string& problem) {
+		throw std::runtime_error("baked file " + h5_file_name + " " + problem);
+	};
+	baked_file.reset(new MappedFile());
+	const char* base = baked_file->Open(h5_file_name) ? baked_file->Map(0, baked_file->GetSize()) : nullptr;
+	if (base == nullptr) {
+		fail("could not be mapped");
+	}
+	uint64_t file_size = baked_file->GetSize();
+	const BakedHeader* header = (const BakedHeader*)base;
+	if (file_size < sizeof(BakedHeader)) {
+		fail("is truncated");
+	}
+	if (std::memcmp(header->magic, kBakedMagic, sizeof(kBakedMagic)) != 0) {
+		fail("was written by an older version, bake it again");
+	}
+	if (header->byte_order != kBakedByteOrder) {
+		fail("was written on a host of the other byte order, bake it again");
+	}
+	if (header->version != kBakedVersion) {
+		fail("has version " + std::to_string(header->version) + ", expected " + std::to_string(kBakedVersion) + ", bake it again");
+	}
+	if (header->num_entries > (file_size - sizeof(BakedHeader)) / sizeof(BakedEntry)) {
+		fail("is truncated");
+	}
+	// every array has to lie inside the file before anything points into it
+	const BakedEntry* entries = (const BakedEntry*)(base + sizeof(BakedHeader));
+	uint64_t data_begin = sizeof(BakedHeader) + sizeof(BakedEntry) * (uint64_t)header->num_entries;
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		const BakedEntry& entry = entries[i];
+		bool inside = entry.offset >= data_begin && entry.offset <= file_size && entry.offset % sizeof(double) == 0;
+		uint64_t max_values = inside ? (file_size - entry.offset) / sizeof(double) : 0;
+		bool fits = entry.dims[0] == 0 || entry.dims[1] == 0 || entry.dims[2] == 0;
+		if (!fits) {
+			// compared by division, the product of the dims can overflow
+			fits = entry.dims[0] <= max_values && entry.dims[1] <= max_values / entry.dims[0] &&
+				entry.dims[2] <= max_values / ((uint64_t)entry.dims[0] * entry.dims[1]);
+		}
+		if (!inside || !fits || std::memchr(entry.name, 0, sizeof(entry.name)) == nullptr) {
+			fail("is damaged or truncated (entry " + std::to_string(i) + ")");
+		}
+	}
+	auto find = [&](const std::string& name, hsize_t* dims, uint64_t min_values = 1) -> const double* {
+		for (uint32_t i = 0; i < header->num_entries; i++) {
+			if (name == entries[i].name) {
+				uint64_t num_values = (uint64_t)entries[i].dims[0] * entries[i].dims[1] * entries[i].dims[2];
+				if (num_values < min_values) {
+					fail("has too few values in " + name);
+				}
+				if (dims != nullptr) {
+					for (int d = 0; d < 3; d++) {
+						dims[d] = entries[i].dims[d];
+					}
+				}
+				return (const double*)(base + entries[i].offset);
+			}
+		}
+		fail("has no " + name);
+		return nullptr;
+	};
+	hsize_t dims[3];
+	rho = *find("simulation_parameters/rho", nullptr);
+	g = *find("simulation_parameters/g", nullptr);
+	const double* values = find("simulation_parameters/w", freq_dims);
+	freq_list.assign(values, values + freq_dims[0]);
+	values = find("simulation_parameters/wave_dir", dims);
+	wave_headings.assign(values, values + dims[0]);
+
+	values = find(bodyNum + "/hydro_coeffs/linear_restoring_stiffness", dims);
+	lin_matrix = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(values, dims[0], dims[1]);
+	values = find(bodyNum + "/hydro_coeffs/added_mass/inf_freq", dims);
+	inf_added_mass = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(values, dims[0], dims[1]);
+	values = find(bodyNum + "/properties/cb", nullptr, 3);
+	cb = ChVector<double>(values[0], values[1], values[2]);
+	values = find(bodyNum + "/properties/cg", nullptr, 3);
+	cg = ChVector<double>(values[0], values[1], values[2]);
+	disp_vol = *find(bodyNum + "/properties/disp_vol", nullptr);
+	body_number = (int)*find(bodyNum + "/properties/body_number", nullptr);
+
+	rirf_matrix = find(bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/K", rirf_dims);
+	values = find(bodyNum + "/hydro_coeffs/radiation_damping/impulse_response_fun/t", dims);
+	rirf_time_vector.assign(values, values + dims[0]);
+	// B(w) and A(w) are empty for h5 files without them
+	radiation_damping_matrix = find(bodyNum + "/hydro_coeffs/radiation_damping/all", radiation_damping_dims, 0);
+	added_mass_matrix = find(bodyNum + "/hydro_coeffs/added_mass/all", added_mass_dims, 0);
+	if (radiation_damping_dims[0] * radiation_damping_dims[1] * radiation_damping_dims[2] == 0) {
+		radiation_damping_matrix = nullptr;
+	}
+	if (added_mass_dims[0] * added_mass_dims[1] * added_mass_dims[2] == 0) {
+		added_mass_matrix = nullptr;
+	}
+	excitation_mag_matrix = find(bodyNum + "/hydro_coeffs/excitation/mag", excitation_mag_dims);
+	excitation_phase_matrix = find(bodyNum + "/hydro_coeffs/excitation/phase", excitation_phase_dims);
+	excitation_re_matrix = find(bodyNum + "/hydro_coeffs/excitation/re", excitation_re_dims);
+	excitation_im_matrix = find(bodyNum + "/hydro_coeffs/excitation/im", excitation_im_dims);
+	FindCouplingPatterns();
+}
+
+H5FileInfo::H5FileInfo() : rirf_matrix(nullptr), rirf_dims(), radiation_damping_matrix(nullptr), radiation_damping_dims(), added_mass_matrix(nullptr),
+	added_mass_dims(), excitation_mag_matrix(nullptr), excitation_mag_dims(), excitation_phase_matrix(nullptr), excitation_phase_dims(),
+	excitation_re_matrix(nullptr), excitation_re_dims(), excitation_im_matrix(nullptr), excitation_im_dims(), freq_dims() {}
+
+H5FileInfo::~H5FileInfo() {}
+
 /*******************************************************************************
 * H5FileInfo constructor
 * requires file name (in absolute file name or referenced from executable location)
 * and body name (name of body's section in H5 file, ie "body1" etc)
 * each body in system should have its own H5FileInfo object
-* calls readH5Data()
+* calls readH5Data(), or readBakedData() for files written by Bake(), and
+* throws what they throw for unreadable files
 *******************************************************************************/
-H5FileInfo::H5FileInfo(std::string file, std::string bodyName) {
+H5FileInfo::H5FileInfo(std::string file, std::string bodyName) : H5FileInfo() {
 	h5_file_name = file;
 	bodyNum = bodyName;
-	readH5Data();
+	if (IsBakedFile(file)) {
+		readBakedData();
+	}
+	else {
+		readH5Data();
+	}
+}
+
+/*******************************************************************************
+* H5FileInfo::Load()
+* returns the shared, read only H5FileInfo of body_name in file, reading it only
+* the first time any thread asks for that (file, body) pair. All bodies and
+* HydroForces using the same data share one copy until ClearCache()
+* throws like the constructor, a file that fails to load isn't cached
+*******************************************************************************/
+std::shared_ptr<const H5FileInfo> H5FileInfo::Load(std::string file, std::string body_name) {
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::absolute(file, error).lexically_normal();
+	auto key = std::make_pair(error ? file : path.string(), body_name);
+	std::lock_guard<std::mutex> lock(H5CacheMutex());
+	auto found = H5Cache().find(key);
+	if (found != H5Cache().end()) {
+		return found->second;
+	}
+	std::shared_ptr<const H5FileInfo> info = std::make_shared<H5FileInfo>(file, body_name);
+	H5Cache()[key] = info;
+	return info;
+}
+
+/*******************************************************************************
+* H5FileInfo::ClearCache()
+* drops the cache's references, data still used by a HydroForces stays alive
+* until that is destroyed
+*******************************************************************************/
+void H5FileInfo::ClearCache() {
+	std::lock_guard<std::mutex> lock(H5CacheMutex());
+	H5Cache().clear();
 }
 
 /*******************************************************************************
 * H5FileInfo::GetHydrostaticStiffnessMatrix()
-* returns the linear restoring stiffness matrix
+* returns the linear restoring stiffness matrix (scaled by rho g), no copy
 *******************************************************************************/
-ChMatrixDynamic<double> H5FileInfo::GetHydrostaticStiffnessMatrix() const {
+const ChMatrixDynamic<double>& H5FileInfo::GetHydrostaticStiffnessMatrix() const {
 	return lin_matrix;
 }
 
 /*******************************************************************************
 * H5FileInfo::GetInfAddedMassMatrix()
-* returns the added mass matrix at infinite frequency
+* returns the added mass matrix at infinite frequency (scaled by rho), no copy
+*******************************************************************************/
+const ChMatrixDynamic<double>& H5FileInfo::GetInfAddedMassMatrix() const {
+	return inf_added_mass;
+}
+
+/*******************************************************************************
+* H5FileInfo::FindCouplingPatterns()
+* private member function called once the coefficients are read, finds the
+* nonzero entries of the stiffness, added mass and excitation coefficients
+* (the RIRF's are found when it is loaded, see LoadRIRF())
+*******************************************************************************/
+void H5FileInfo::FindCouplingPatterns() {
+	Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> row_major = lin_matrix;
+	hydrostatic_stiffness_pattern = CouplingPattern((int)row_major.rows(), (int)row_major.cols(), row_major.data());
+	row_major = inf_added_mass;
+	inf_added_mass_pattern = CouplingPattern((int)row_major.rows(), (int)row_major.cols(), row_major.data());
+	if (excitation_re_matrix != nullptr && excitation_im_matrix != nullptr) {
+		std::vector<double> magnitude((size_t)excitation_re_dims[0] * excitation_re_dims[1] * excitation_re_dims[2]);
+		for (size_t i = 0; i < magnitude.size(); i++) {
+			magnitude[i] = std::abs(excitation_re_matrix[i]) + std::abs(excitation_im_matrix[i]);
+		}
+		excitation_pattern = CouplingPattern((int)excitation_re_dims[0], (int)excitation_re_dims[1], magnitude.data(), (int)excitation_re_dims[2]);
+	}
+}
+
+/*******************************************************************************
+* H5FileInfo::GetHydrostaticStiffnessPattern()
+* returns the nonzero entries of the linear restoring stiffness matrix
+*******************************************************************************/
+const CouplingPattern& H5FileInfo::GetHydrostaticStiffnessPattern() const {
+	return hydrostatic_stiffness_pattern;
+}
+
+/*******************************************************************************
+* H5FileInfo::GetInfAddedMassPattern()
+* returns the nonzero entries of the added mass matrix at infinite frequency
+*******************************************************************************/
+const CouplingPattern& H5FileInfo::GetInfAddedMassPattern() const {
+	return inf_added_mass_pattern;
+}
+
+/*******************************************************************************
+* H5FileInfo::GetRIRFPattern()
+* returns the (row, col) entries of the RIRF that aren't zero at every step,
+* loading the RIRF if needed
 *******************************************************************************/
-ChMatrixDynamic<double> H5FileInfo::GetInfAddedMassMatrix() const {
-	return inf_added_mass * rho;
+const CouplingPattern& H5FileInfo::GetRIRFPattern() const {
+	LoadRIRF();
+	return rirf_pattern;
+}
+
+/*******************************************************************************
+* H5FileInfo::GetExcitationPattern()
+* returns the (row, wave heading) pairs whose excitation isn't zero at every
+* frequency
+*******************************************************************************/
+const CouplingPattern& H5FileInfo::GetExcitationPattern() const {
+	return excitation_pattern;
 }
 
 /*******************************************************************************
@@ -310,28 +673,111 @@ double H5FileInfo::GetDisplacementVolume() const {
 
 /*******************************************************************************
 * H5FileInfo::GetRIRFval()
-* returns impulse response coeff for row m, column n, step s
+* returns impulse response coeff for row m, column n, step s, 0 out of bounds
+* (no output here, this is called from the force evaluation of every thread)
 *******************************************************************************/
 double H5FileInfo::GetRIRFval(int m, int n, int s) const {
 	int index = s + rirf_dims[2] * (n + m * rirf_dims[1]);
 	if (index < 0 || index >= rirf_dims[0] * rirf_dims[1] * rirf_dims[2]) {
-		std::cout << "out of bounds IRF\n";
 		return 0;
 	}
 	else {
-		return rirf_matrix[index] * GetRho(); // scale radiation force by rho
+		LoadRIRF();
+		return rirf_matrix[index];
 	}
 }
 
 /*******************************************************************************
-* H5FileInfo::GetRIRFDims(int i) returns the i-th component of the dimensions of radiation_damping_matrix
+* H5FileInfo::GetRIRFEntry()
+* view of the impulse response of row m, column n at every step (scaled by
+* rho), pointing into the loaded or mapped RIRF. Empty out of bounds
+*******************************************************************************/
+Eigen::Map<const ChVectorDynamic<double>> H5FileInfo::GetRIRFEntry(int m, int n) const {
+	LoadRIRF();
+	return EntryView(rirf_matrix, rirf_dims, m, n);
+}
+
+/*******************************************************************************
+* H5FileInfo::GetRIRFDims(int i) returns the i-th component of the dimensions of rirf_matrix
 * i = [0,1,2] -> [number of rows, number of columns, number of matrices]
 *******************************************************************************/
 int H5FileInfo::GetRIRFDims(int i) const {
 	return rirf_dims[i];
 }
 
-//TODO: Get B(w)
+/*******************************************************************************
+* H5FileInfo::GetRadiationDampingValue()
+* returns radiation damping B for row i, column j, frequency ix k, scaled by rho,
+* 0 if the file has no frequency dependent radiation damping
+*******************************************************************************/
+double H5FileInfo::GetRadiationDampingValue(int i, int j, int k) const {
+	LoadRadiationDamping();
+	if (radiation_damping_matrix == nullptr) {
+		return 0.0;
+	}
+	int index = k + radiation_damping_dims[2] * (j + radiation_damping_dims[1] * i);
+	return radiation_damping_matrix[index];
+}
+
+/*******************************************************************************
+* H5FileInfo::GetRadiationDampingEntry()
+* view of the radiation damping B of row i, column j at every frequency
+* (scaled by rho), empty out of bounds or if the file has no frequency
+* dependent radiation damping
+*******************************************************************************/
+Eigen::Map<const ChVectorDynamic<double>> H5FileInfo::GetRadiationDampingEntry(int i, int j) const {
+	LoadRadiationDamping();
+	return EntryView(radiation_damping_matrix, radiation_damping_dims, i, j);
+}
+
+/*******************************************************************************
+* H5FileInfo::GetRadiationDampingDims(int i) returns the i-th component of the dimensions of radiation_damping_matrix
+* i = [0,1,2] -> [number of rows, number of columns, number of frequencies]
+*******************************************************************************/
+int H5FileInfo::GetRadiationDampingDims(int i) const {
+	return radiation_damping_dims[i];
+}
+
+/*******************************************************************************
+* H5FileInfo::GetAddedMassValue()
+* returns the added mass A for row i, column j, frequency ix k, scaled by rho,
+* 0 if the file has no frequency dependent added mass
+*******************************************************************************/
+double H5FileInfo::GetAddedMassValue(int i, int j, int k) const {
+	LoadAddedMass();
+	if (added_mass_matrix == nullptr) {
+		return 0.0;
+	}
+	int index = k + added_mass_dims[2] * (j + added_mass_dims[1] * i);
+	return added_mass_matrix[index];
+}
+
+/*******************************************************************************
+* H5FileInfo::GetAddedMassEntry()
+* view of the added mass A of row i, column j at every frequency (scaled by
+* rho), empty out of bounds or if the file has no frequency dependent added mass
+*******************************************************************************/
+Eigen::Map<const ChVectorDynamic<double>> H5FileInfo::GetAddedMassEntry(int i, int j) const {
+	LoadAddedMass();
+	return EntryView(added_mass_matrix, added_mass_dims, i, j);
+}
+
+/*******************************************************************************
+* H5FileInfo::GetAddedMassDims(int i) returns the i-th component of the dimensions of added_mass_matrix
+* i = [0,1,2] -> [number of rows, number of columns, number of frequencies]
+*******************************************************************************/
+int H5FileInfo::GetAddedMassDims(int i) const {
+	return added_mass_dims[i];
+}
+
+/*******************************************************************************
+* H5FileInfo::GetBodyNumber()
+* returns the body's number in the h5 file (1 based), body n's DOFs are columns
+* 6(n-1) .. 6(n-1)+5 of coupled coefficients like the RIRF
+*******************************************************************************/
+int H5FileInfo::GetBodyNumber() const {
+	return body_number;
+}
 
 /*******************************************************************************
 * H5FileInfo::GetNumFreqs()
@@ -371,7 +817,7 @@ double H5FileInfo::GetOmegaDelta() const {
 *******************************************************************************/
 double H5FileInfo::GetExcitationMagValue(int i, int j, int k) const {
 	int indexExMag = k + excitation_mag_dims[2] * i;
-	return excitation_mag_matrix[indexExMag] * rho * g;
+	return excitation_mag_matrix[indexExMag];
 }
 
 /*******************************************************************************
@@ -410,75 +856,148 @@ double H5FileInfo::GetExcitationPhaseInterp(int i, int j, double freq_index_des)
 }
 
 /*******************************************************************************
-* H5FileInfo::GetRIRFdt() returns the difference in first 2 rirf_time_vector
+* H5FileInfo::GetExcitationReValue()
+* returns the real part of the excitation coefficient for row i, column
+* (wave heading) j, frequency ix k
 *******************************************************************************/
-double H5FileInfo::GetRIRFdt() const {
-	return rirf_time_vector[1] - rirf_time_vector[0];
+double H5FileInfo::GetExcitationReValue(int i, int j, int k) const {
+	int indexExRe = k + excitation_re_dims[2] * (j + excitation_re_dims[1] * i);
+	return excitation_re_matrix[indexExRe];
 }
 
 /*******************************************************************************
-* H5FileInfo::GetRIRFTimeVector()
-* returns the vector of rirf_time_vector from h5 file
+* H5FileInfo::GetExcitationReInterp()
+* returns the real part of the excitation coefficient for row i, column j,
+* linearly interpolated at fractional frequency ix freq_index_des
 *******************************************************************************/
-std::vector<double> H5FileInfo::GetRIRFTimeVector() const {
-	return rirf_time_vector;
+double H5FileInfo::GetExcitationReInterp(int i, int j, double freq_index_des) const {
+	double freq_interp_val = freq_index_des - floor(freq_index_des);
+	double excitationReFloor = GetExcitationReValue(i, j, floor(freq_index_des));
+	double excitationReCeil = GetExcitationReValue(i, j, floor(freq_index_des) + 1);
+	return (freq_interp_val * (excitationReCeil - excitationReFloor)) + excitationReFloor;
 }
 
-// =============================================================================
-// HydroInputs Class Definitions
-// =============================================================================
+/*******************************************************************************
+* H5FileInfo::GetExcitationImValue()
+* returns the imaginary part of the excitation coefficient for row i, column
+* (wave heading) j, frequency ix k
+*******************************************************************************/
+double H5FileInfo::GetExcitationImValue(int i, int j, int k) const {
+	int indexExIm = k + excitation_im_dims[2] * (j + excitation_im_dims[1] * i);
+	return excitation_im_matrix[indexExIm];
+}
 
 /*******************************************************************************
-* HydroInputs constructor
-* does nothing (yet?)
+* H5FileInfo::GetExcitationImInterp()
+* returns the imaginary part of the excitation coefficient for row i, column j,
+* linearly interpolated at fractional frequency ix freq_index_des
 *******************************************************************************/
-HydroInputs::HydroInputs() {
+double H5FileInfo::GetExcitationImInterp(int i, int j, double freq_index_des) const {
+	double freq_interp_val = freq_index_des - floor(freq_index_des);
+	double excitationImFloor = GetExcitationImValue(i, j, floor(freq_index_des));
+	double excitationImCeil = GetExcitationImValue(i, j, floor(freq_index_des) + 1);
+	return (freq_interp_val * (excitationImCeil - excitationImFloor)) + excitationImFloor;
+}
 
+/*******************************************************************************
+* H5FileInfo::GetNumWaveHeadings()
+* returns the number of wave headings the excitation coefficients are given for
+*******************************************************************************/
+int H5FileInfo::GetNumWaveHeadings() const {
+	return (int)wave_headings.size();
 }
 
-// =============================================================================
-// ForceTorqueFunc Class Definitions
-// =============================================================================
+/*******************************************************************************
+* H5FileInfo::GetWaveHeading()
+* returns the j-th wave heading in degrees
+*******************************************************************************/
+double H5FileInfo::GetWaveHeading(int j) const {
+	return wave_headings[j];
+}
 
 /*******************************************************************************
-* ForceTorqueFunc constructor
-* sets pointer to HydroForces member object and index for which component
-* this ForceTorqueFunc object refers to
+* H5FileInfo::GetExcitationInterp()
+* returns the complex excitation coefficient of row i for a wave of frequency
+* omega (rad/s) from heading (degrees), linearly interpolated in frequency and
+* heading. Frequencies and headings outside the h5 file's range are clamped
+* to the nearest one computed
 *******************************************************************************/
-ForceTorqueFunc::ForceTorqueFunc(HydroForces* b, int i) : base(b), index(i) {	}
+std::complex<double> H5FileInfo::GetExcitationInterp(int i, double omega, double heading) const {
+	// frequency k is (k + 1) * GetOmegaDelta(), the last index that can be interpolated from is nf - 2 (+1)
+	double freq_index_des = omega / GetOmegaDelta() - 1;
+	freq_index_des = std::min(std::max(freq_index_des, 0.0), GetNumFreqs() - 1.000001);
+	int num_headings = GetNumWaveHeadings();
+	int j = 0;
+	double heading_interp_val = 0.0;
+	if (num_headings > 1 && heading > wave_headings[0]) {
+		while (j < num_headings - 2 && heading > wave_headings[j + 1]) {
+			j++;
+		}
+		heading_interp_val = std::min((heading - wave_headings[j]) / (wave_headings[j + 1] - wave_headings[j]), 1.0);
+	}
+	std::complex<double> excitation(GetExcitationReInterp(i, j, freq_index_des), GetExcitationImInterp(i, j, freq_index_des));
+	if (heading_interp_val > 0.0) {
+		std::complex<double> next(GetExcitationReInterp(i, j + 1, freq_index_des), GetExcitationImInterp(i, j + 1, freq_index_des));
+		excitation += heading_interp_val * (next - excitation);
+	}
+	return excitation;
+}
 
 /*******************************************************************************
-* ForceTorqueFunc::Clone()
-* required override function since ForceTorqueFunc inherits from ChFunction
+* H5FileInfo::GetRIRFdt() returns the difference in first 2 rirf_time_vector
 *******************************************************************************/
-ForceTorqueFunc* ForceTorqueFunc::Clone() const  {
-	return new ForceTorqueFunc(*this);
+double H5FileInfo::GetRIRFdt() const {
+	return rirf_time_vector[1] - rirf_time_vector[0];
 }
 
 /*******************************************************************************
-* ForceTorqueFunc::Get_y()
-* returns the value of the index-th coordinate of the linear restoring force
-* at each time
-* required override function since ForceTorqueFunc inherits from ChFunction
+* H5FileInfo::GetRIRFTimeVector()
+* returns the vector of rirf_time_vector from h5 file
 *******************************************************************************/
-double ForceTorqueFunc::Get_y(double x) const {
-	return base->coordinateFunc(index);
+const std::vector<double>& H5FileInfo::GetRIRFTimeVector() const {
+	return rirf_time_vector;
 }
 
 /*******************************************************************************
-* ForceTorqueFunc::SetBase
-* currently unused(?) function to set base if not set in constructor
+* H5FileInfo::GetFrequencyVector()
+* returns the frequencies (rad/s) the frequency dependent coefficients are given at
 *******************************************************************************/
-void ForceTorqueFunc::SetBase(HydroForces* b) {
-	base = b;
+const std::vector<double>& H5FileInfo::GetFrequencyVector() const {
+	return freq_list;
 }
 
+// =============================================================================
+// HydroInputs Class Definitions
+// =============================================================================
+
 /*******************************************************************************
-* ForceTorqueFunc::SetIndex
-* currently unused(?) function to set index if not set in constructor
+* HydroInputs constructor
+* defaults to a regular wave switched on at once, direct convolution of the RIRF as sampled in the
+* h5 file for the radiation force and linear hydrostatics, irregular seas
+* default to a JONSWAP spectrum with gamma = 3.3
 *******************************************************************************/
-void ForceTorqueFunc::SetIndex(int i) {
-	index = i;
+HydroInputs::HydroInputs() {
+	regular_wave_amplitude = 0.0;
+	regular_wave_omega = 0.0;
+	wave_heading = 0.0;
+	excitation_ramp_time = 0.0;
+	wave_mode = WaveMode::REGULAR;
+	irregular_wave_height = 0.0;
+	irregular_wave_peak_period = 0.0;
+	irregular_wave_gamma = 3.3;
+	irregular_wave_num_components = 500;
+	irregular_wave_seed = 1;
+	irregular_wave_omega_min = 0.0;
+	irregular_wave_omega_max = 0.0;
+	irregular_wave_precompute = false;
+	irregular_wave_time_step = 0.0;
+	irregular_wave_duration = 3600.0;
+	radiation_mode = RadiationMode::CONVOLUTION;
+	radiation_time_step = 0.0;
+	rirf_truncation_tolerance = 0.0;
+	ss_max_order = 10;
+	ss_tolerance = 0.01;
+	hydrostatics_mode = HydrostaticsMode::LINEAR;
 }
 
 // =============================================================================
@@ -487,82 +1006,282 @@ void ForceTorqueFunc::SetIndex(int i) {
 
 /*******************************************************************************
 * HydroForces default constructor
-* initializes array of ForceTorqueFunc objects and pointers to each force/torque
 *******************************************************************************/
-HydroForces::HydroForces() : forces{ {this, 0}, {this, 1}, {this, 2}, {this, 3}, {this, 4}, {this, 5} } {
-	for (unsigned i = 0; i < 6; i++) {
-		force_ptrs[i] = std::shared_ptr<ForceTorqueFunc>(forces + i, [](ForceTorqueFunc*) {});
-		// sets force_ptrs[i] to point to forces[i] but since forces is on the stack, it is faster and it is
-		// automatically deallocated...shared pointers typically manage heap pointers, and will try deleting
-		// them as soon as done. Doesn't work on stack array (can't delete stack arrays), we overload the
-		// default deletion logic to do nothing
-		// Also! don't need to worry about deleting this later, because stack arrays are always deleted automatically
-	}
-	chrono_force = chrono_types::make_shared<ChForce>();
-	chrono_torque = chrono_types::make_shared<ChForce>();
+HydroForces::HydroForces() : has_cached_state(false), velocity_history_time(-1) {
+	force_hydrostatics.setZero();
+	force_total.setZero();
 }
 
 /*******************************************************************************
 * HydroForces constructor
 * calls default constructor and initializes hydro force info
-* from H5FileInfo
-* also initializes ChBody that this force will be applied to
+* from one H5FileInfo per body
+* also initializes the ChBody objects these forces will be applied to
+* all bodies must come from the same h5 file, their radiation is coupled
+* through a single 6N x 6N kernel and one shared velocity history, bodies whose
+* RIRF dimensions differ, or a precomputed irregular wave without its time
+* step, throw std::invalid_argument, a precomputed series file that can't be
+* mapped throws std::runtime_error
 *******************************************************************************/
-HydroForces::HydroForces(H5FileInfo& h5_file_info, std::shared_ptr<ChBody> object, HydroInputs user_hydro_inputs) : HydroForces() {
-	body = object;
-	file_info = h5_file_info;
+HydroForces::HydroForces(std::vector<std::shared_ptr<const H5FileInfo>> h5_file_infos, std::vector<std::shared_ptr<ChBody>> objects, HydroInputs user_hydro_inputs) : HydroForces() {
+	bodies = objects;
+	file_info = h5_file_infos;
 	hydro_inputs = user_hydro_inputs;
+	// notes are kept for PrintReport(), many HydroForces are built at once in sweeps
+	std::ostringstream notes;
+	int num_bodies = (int)bodies.size();
+	int num_dofs = 6 * num_bodies;
 	// define wave inputs here
-	// TODO: switch depending on wave option (regular, regularCIC, irregular, noWaveCIC)
 	wave_amplitude = hydro_inputs.GetRegularWaveAmplitude();
 	wave_omega = hydro_inputs.GetRegularWaveOmega();
-	wave_omega_delta = file_info.GetOmegaDelta();
-	freq_index_des = (wave_omega / wave_omega_delta) - 1;
 
-	for (int rowEx = 0; rowEx < 6; rowEx++) {
-		excitation_force_mag[rowEx] = file_info.GetExcitationMagInterp(rowEx, 0, freq_index_des);
-		excitation_force_phase[rowEx] = file_info.GetExcitationPhaseInterp(rowEx, 0, freq_index_des);
+	// complex regular wave force amplitude A X(w, heading) of every DOF
+	excitation_force_re.setZero(num_dofs);
+	excitation_force_im.setZero(num_dofs);
+	equilibrium.resize(num_dofs);
+	for (int b = 0; b < num_bodies; b++) {
+		if (hydro_inputs.GetWaveMode() == WaveMode::REGULAR) {
+			for (int rowEx = 0; rowEx < 6; rowEx++) {
+				if (!file_info[b]->GetExcitationPattern().IsRowNonzero(rowEx)) {
+					continue;
+				}
+				std::complex<double> excitation = wave_amplitude * file_info[b]->GetExcitationInterp(rowEx, wave_omega, hydro_inputs.GetWaveHeading());
+				excitation_force_re[6 * b + rowEx] = excitation.real();
+				excitation_force_im[6 * b + rowEx] = excitation.imag();
+			}
+		}
+		// set equilibrium to (cg0, cg1, cg2, 0, 0, 0)
+		equilibrium.segment<6>(6 * b) << file_info[b]->GetEquilibriumCoG().eigen(), 0, 0, 0;
+	}
+
+	if (hydro_inputs.GetHydrostaticsMode() == HydrostaticsMode::NONLINEAR) {
+		// mesh vertices are in the h5 file's frame, where the body reference point sits at the equilibrium cg
+		std::vector<std::string> mesh_files = hydro_inputs.GetHydrostaticsMeshFiles();
+		nonlinear_hydrostatics.resize(num_bodies);
+		for (int b = 0; b < num_bodies; b++) {
+			std::vector<double> vertices;
+			std::vector<int> triangles;
+			std::string error = "no mesh file given";
+			if (b >= (int)mesh_files.size() || !NonlinearHydrostatics::ReadObj(mesh_files[b], vertices, triangles, &error)) {
+				notes << "no mesh for body " << b + 1 << " (" << error << "), using linear hydrostatics\n";
+				continue;
+			}
+			ChVector<> cg = file_info[b]->GetEquilibriumCoG();
+			double origin[3] = { cg.x(), cg.y(), cg.z() };
+			nonlinear_hydrostatics[b] = NonlinearHydrostatics(vertices, triangles, origin, file_info[b]->GetRho() * file_info[b]->GetGravity());
+			notes << "nonlinear hydrostatics body " << b + 1 << ": " << nonlinear_hydrostatics[b].GetNumPanels() << " panels, enclosed volume "
+				<< nonlinear_hydrostatics[b].GetVolume() << " m^3\n";
+			if (nonlinear_hydrostatics[b].GetNumOpenEdges() > 0) {
+				notes << "mesh " << mesh_files[b] << " is not closed (" << nonlinear_hydrostatics[b].GetNumOpenEdges()
+					<< " open edges), the pressure on the missing surface is not included\n";
+			}
+		}
+	}
+
+	if (hydro_inputs.GetWaveMode() == WaveMode::IRREGULAR) {
+		// components outside the h5 file's frequency range have no excitation data
+		double omega_min = hydro_inputs.GetIrregularWaveOmegaMin() > 0 ? hydro_inputs.GetIrregularWaveOmegaMin() : file_info[0]->GetOmegaMin();
+		double omega_max = hydro_inputs.GetIrregularWaveOmegaMax() > 0 ? hydro_inputs.GetIrregularWaveOmegaMax() : file_info[0]->GetOmegaMax();
+		omega_min = std::max(omega_min, file_info[0]->GetOmegaMin());
+		omega_max = std::min(omega_max, file_info[0]->GetOmegaMax());
+		bool precompute = hydro_inputs.GetIrregularWavePrecompute();
+		double dt = hydro_inputs.GetIrregularWaveTimeStep();
+		if (precompute && dt <= 0) {
+			throw std::invalid_argument("precomputed irregular wave excitation needs the simulation time step (SetIrregularWaveTimeStep)");
+		}
+		std::vector<double> coef_re, coef_im;
+		if (precompute) {
+			// components on the FFT bins of the simulation time grid, below the Nyquist frequency
+			const double pi = 3.14159265358979323846;
+			int num_samples = ExcitationTimeSeries::GetNumSamples(dt, hydro_inputs.GetIrregularWaveDuration());
+			double d_omega = 2 * pi / (num_samples * dt);
+			WaveComponents components = MakeJonswapComponentsOnGrid(hydro_inputs.GetIrregularWaveHeight(), hydro_inputs.GetIrregularWavePeakPeriod(),
+				hydro_inputs.GetIrregularWaveGamma(), omega_min, std::min(omega_max, pi / dt * (1 - 1e-9)), d_omega, hydro_inputs.GetIrregularWaveSeed());
+			ComputeExcitationCoefficients(components, coef_re, coef_im);
+			std::vector<int> bins(components.omega.size());
+			for (size_t k = 0; k < bins.size(); k++) {
+				bins[k] = (int)std::lround(components.omega[k] / d_omega);
+			}
+			excitation_time_series = ExcitationTimeSeries(num_dofs, dt, num_samples, bins, coef_re, coef_im, hydro_inputs.GetIrregularWaveSeriesFile());
+			if (!hydro_inputs.GetIrregularWaveSeriesFile().empty() && !excitation_time_series.IsFileBacked()) {
+				notes << "could not create excitation time series file " << hydro_inputs.GetIrregularWaveSeriesFile() << ", keeping it in memory\n";
+			}
+			notes << "irregular wave excitation: " << bins.size() << " components, " << num_samples << " steps ("
+				<< excitation_time_series.GetPeriod() << " s period, " << excitation_time_series.GetNumBytes() / (1024.0 * 1024.0) << " MB "
+				<< (excitation_time_series.IsFileBacked() ? "mapped file" : "in memory") << ")\n";
+		}
+		else {
+			WaveComponents components = MakeJonswapComponents(hydro_inputs.GetIrregularWaveHeight(), hydro_inputs.GetIrregularWavePeakPeriod(),
+				hydro_inputs.GetIrregularWaveGamma(), omega_min, omega_max, hydro_inputs.GetIrregularWaveNumComponents(), hydro_inputs.GetIrregularWaveSeed());
+			ComputeExcitationCoefficients(components, coef_re, coef_im);
+			irregular_excitation = IrregularWaveExcitation(num_dofs, components.omega, coef_re, coef_im);
+		}
 	}
 
-  // set equilibrium to (cg0, cg1, cg2, 0, 0, 0)
-	equilibrium << file_info.GetEquilibriumCoG().eigen(), 0, 0, 0;
-	previous_time = -1;
-	previous_time_rirf = -1;
-	velocity_history.resize(file_info.GetRIRFDims(2));
-	rirf_time_vector = file_info.GetRIRFTimeVector();
-	ChVectorN<double, 6> temp;
-	for (int i = 0; i < 6; i++) {
-		temp[i] = 0;
-		force_hydrostatic[i] = 0;
+	// stack every body's 6 RIRF rows into one (6 * num_bodies) x (6 * bodies in file) kernel
+	int num_cols = file_info[0]->GetRIRFDims(1);
+	int num_steps = file_info[0]->GetRIRFDims(2);
+	for (int b = 1; b < num_bodies; b++) {
+		if (file_info[b]->GetRIRFDims(1) != num_cols || file_info[b]->GetRIRFDims(2) != num_steps) {
+			throw std::invalid_argument("RIRF dimensions of body " + std::to_string(b + 1) + " do not match body 1, bodies must come from the same h5 file");
+		}
+	}
+	std::vector<double> rirf((size_t)num_dofs * num_cols * num_steps);
+	rirf_col_offset.resize(num_bodies);
+	for (int b = 0; b < num_bodies; b++) {
+		const CouplingPattern& rirf_pattern = file_info[b]->GetRIRFPattern();
+		for (int row = 0; row < 6; row++) {
+			for (int col = 0; col < num_cols; col++) {
+				if (!rirf_pattern.IsNonzero(row, col)) {
+					continue;
+				}
+				auto entry = file_info[b]->GetRIRFEntry(row, col);
+				std::copy(entry.data(), entry.data() + std::min(num_steps, (int)entry.size()), &rirf[((size_t)(6 * b + row) * num_cols + col) * num_steps]);
+			}
+		}
+		// uncoupled files (6 columns) only hold the body's own DOFs
+		rirf_col_offset[b] = num_cols > 6 ? 6 * (file_info[b]->GetBodyNumber() - 1) : 0;
+	}
+	std::vector<double> rirf_time_vector = file_info[0]->GetRIRFTimeVector();
+	rirf_time_vector.resize(num_steps);
+	radiation_velocity.assign(num_cols, 0.0);
+	if (hydro_inputs.GetRadiationMode() == RadiationMode::STATE_SPACE) {
+		radiation_state_space = RadiationStateSpace(num_dofs, num_cols, rirf, rirf_time_vector, hydro_inputs.GetStateSpaceMaxOrder(), hydro_inputs.GetStateSpaceTolerance());
+	}
+	else {
+		// the convolution history advances one sample per simulation step, so the kernel has to be sampled at that step
+		double dt = hydro_inputs.GetRadiationTimeStep();
+		double rirf_dt = file_info[0]->GetRIRFdt();
+		if (dt > 0.0 && std::abs(dt - rirf_dt) > 1e-9 * rirf_dt) {
+			std::vector<double> resampled_time_vector;
+			rirf = ResampleRIRF(rirf, num_dofs * num_cols, rirf_time_vector, dt, resampled_time_vector);
+			rirf_time_vector = resampled_time_vector;
+			notes << "RIRF resampled from " << rirf_dt << " s to the " << dt << " s simulation time step (" << rirf_time_vector.size() << " steps)\n";
+		}
+		else if (dt <= 0.0) {
+			notes << "no radiation time step set (SetRadiationTimeStep), the simulation time step must equal the RIRF time step " << rirf_dt << " s\n";
+		}
+		radiation_convolution = RadiationConvolution(num_dofs, num_cols, rirf, rirf_time_vector, hydro_inputs.GetRIRFTruncationTolerance());
 	}
-	for (int i = 0; i < file_info.GetRIRFDims(2); i++) {
-		// initializes every velocity_history elm to (0,0,0,0,0,0)
-		velocity_history[i] = temp;
+
+	force_hydrostatics.setZero(num_dofs);
+	force_radiation_damping.setZero(num_dofs);
+	force_excitation.setZero(num_dofs);
+	force_total.setZero(num_dofs);
+	cached_states.resize(num_bodies);
+	body_profile.resize(num_bodies);
+	ResetProfile();
+	setup_messages = notes.str();
+}
+
+/*******************************************************************************
+* HydroForces::ComputeExcitationCoefficients()
+* complex force amplitude a_k X_j(w_k) e^(i phi_k) of every wave component k on
+* every DOF j ([dof][component]), from the excitation re/im coefficients
+* interpolated at the component frequencies and the wave heading. DOFs the
+* h5 file has no excitation for are left zero
+*******************************************************************************/
+void HydroForces::ComputeExcitationCoefficients(const WaveComponents& components, std::vector<double>& coef_re, std::vector<double>& coef_im) const {
+	int num_dofs = 6 * GetNumBodies();
+	int num_components = (int)components.omega.size();
+	coef_re.assign((size_t)num_dofs * num_components, 0.0);
+	coef_im.assign((size_t)num_dofs * num_components, 0.0);
+	for (int k = 0; k < num_components; k++) {
+		double wave_re = components.amplitude[k] * cos(components.phase[k]);
+		double wave_im = components.amplitude[k] * sin(components.phase[k]);
+		for (int b = 0; b < GetNumBodies(); b++) {
+			for (int rowEx = 0; rowEx < 6; rowEx++) {
+				if (!file_info[b]->GetExcitationPattern().IsRowNonzero(rowEx)) {
+					continue;
+				}
+				std::complex<double> excitation = file_info[b]->GetExcitationInterp(rowEx, components.omega[k], hydro_inputs.GetWaveHeading());
+				double ex_re = excitation.real();
+				double ex_im = excitation.imag();
+				coef_re[(size_t)(6 * b + rowEx) * num_components + k] = wave_re * ex_re - wave_im * ex_im;
+				coef_im[(size_t)(6 * b + rowEx) * num_components + k] = wave_re * ex_im + wave_im * ex_re;
+			}
+		}
 	}
-	offset = 0;
+}
+
+/*******************************************************************************
+* HydroForces::GetBodyState()
+* returns the current time, position and velocity of the b-th ChBody
+*******************************************************************************/
+HydroBodyState HydroForces::GetBodyState(int b) const {
+	HydroBodyState state;
+	state.time = bodies[b]->GetChTime();
+	state.pos = bodies[b]->GetPos();
+	state.rot = bodies[b]->GetRot();
+	state.vel = bodies[b]->GetPos_dt();
+	state.wvel = bodies[b]->GetWvel_par();
+	return state;
+}
+
+/*******************************************************************************
+* HydroForces::ComputeForce()
+* returns the total hydro force vector of all bodies (force and torque per body,
+* absolute frame) for states, one per body. All force terms are evaluated once
+* per distinct set of states, asking again for the same time and states returns
+* the cached vector. A new state at the same time (implicit iterations,
+* substeps) invalidates the cache. The terms stay readable per body through
+* GetForceHydrostatics() etc.
+*******************************************************************************/
+const ChVectorDynamic<double>& HydroForces::ComputeForce(const std::vector<HydroBodyState>& states) {
+	HYDRO_PROFILE_COUNT(profile.force_calls);
+	if (has_cached_state && states == cached_states) {
+		HYDRO_PROFILE_COUNT(profile.force_cache_hits);
+		return force_total;
+	}
+	std::copy(states.begin(), states.end(), cached_states.begin());
+	has_cached_state = true;
+	force_total = ComputeForceRadiationDamping(states) + ComputeForceExcitation(states);
+	for (int b = 0; b < GetNumBodies(); b++) {
+		force_hydrostatics.segment<6>(6 * b) = ComputeForceHydrostatics(b, states[b]);
+	}
+	force_total += force_hydrostatics;
+	return force_total;
 }
 
 /*******************************************************************************
 * HydroForces::ComputeForceHydrostatics()
 * calculates the matrix multiplication each time step for linear restoring stiffness
-* f = [linear restoring stiffness matrix] [displacement vector]
+* f = [linear restoring stiffness matrix] [displacement vector], over the
+* matrix's nonzero entries
+* for the b-th body, or integrates the still water pressure over its wetted
+* mesh surface in NONLINEAR mode (force and torque about the body reference
+* point, absolute frame)
 *******************************************************************************/
-ChVectorN<double, 6> HydroForces::ComputeForceHydrostatics() {
-	if (body->GetChTime() == previous_time) {
+ChVectorN<double, 6> HydroForces::ComputeForceHydrostatics(int b, const HydroBodyState& state) {
+	HYDRO_PROFILE_COUNT(body_profile[b].hydrostatics_calls);
+	HYDRO_PROFILE_TIME(body_profile[b].hydrostatics_ns);
+	ChVectorN<double, 6> force_hydrostatic;
+	if (b < (int)nonlinear_hydrostatics.size() && nonlinear_hydrostatics[b].GetNumPanels() > 0) {
+		double pos[3] = { state.pos.x(), state.pos.y(), state.pos.z() };
+		double rot[9];
+		for (int j = 0; j < 3; j++) {
+			ChVector<> axis = state.rot.Rotate(ChVector<>(j == 0, j == 1, j == 2));
+			rot[j] = axis.x();
+			rot[3 + j] = axis.y();
+			rot[6 + j] = axis.z();
+		}
+		nonlinear_hydrostatics[b].Compute(pos, rot, force_hydrostatic.data());
 		return force_hydrostatic;
 	}
-	previous_time = body->GetChTime();
-	force_hydrostatic << body->GetPos().eigen(), body->GetRot().Q_to_Euler123();
+	ChVectorN<double, 6> displacement;
+	displacement << state.pos.eigen(), state.rot.Q_to_Euler123().eigen();
 
-	force_hydrostatic = force_hydrostatic - equilibrium;
+	displacement = displacement - equilibrium.segment<6>(6 * b);
 
-	double rollLeverArm = force_hydrostatic[3];
-	double pitchLeverArm = force_hydrostatic[4];
-	double yawLeverArm = force_hydrostatic[5];
+	double rollLeverArm = displacement[3];
+	double pitchLeverArm = displacement[4];
+	double yawLeverArm = displacement[5];
 
-	force_hydrostatic = -1 * file_info.GetHydrostaticStiffnessMatrix() * force_hydrostatic;
+	// only the nonzero stiffness entries, most of them are zero for symmetric bodies
+	file_info[b]->GetHydrostaticStiffnessPattern().Multiply(displacement.data(), force_hydrostatic.data());
+	force_hydrostatic = -force_hydrostatic;
 
-	double buoyancy = file_info.GetRho() * file_info.GetGravity() * file_info.GetDisplacementVolume();
+	double buoyancy = file_info[b]->GetRho() * file_info[b]->GetGravity() * file_info[b]->GetDisplacementVolume();
 	force_hydrostatic[2] += buoyancy;
 	force_hydrostatic[3] += buoyancy * rollLeverArm;
 	force_hydrostatic[4] += buoyancy * pitchLeverArm;
@@ -572,122 +1291,437 @@ ChVectorN<double, 6> HydroForces::ComputeForceHydrostatics() {
 }
 
 /*******************************************************************************
-* HydroForces::ComputeForceRadiationDampingConv()
+* HydroForces::ComputeForceRadiationDamping()
+* radiation damping force on all bodies from whichever model HydroInputs selected
 *******************************************************************************/
-ChVectorN<double, 6> HydroForces::ComputeForceRadiationDampingConv() {
-	// since convolutionIntegral called for each DoF each timestep, we only want to
-	// calculate the vector force once each timestep. Save the previous_time_rirf
-	if (body->GetChTime() == previous_time_rirf) {
-		return force_radiation_damping;
-	}
-	previous_time_rirf = body->GetChTime();
-	int size = file_info.GetRIRFDims(2);
-	// "shift" everything left 1
-	offset--;
-	if (offset < -1 * size) {
-		offset += size;
-	}
-	int numRows = file_info.GetRIRFDims(0), numCols = file_info.GetRIRFDims(1);
-	std::cout << "numRows = " << numRows << " numCols = " << numCols << std::endl;
-	double* timeseries = new double[numRows * numCols * size];
-	double* tmp_s = new double[numRows * size];
-	// define shortcuts for accessing 1D arrays as 3D (or 2D) arrays
-#define TIMESERIES(row,col,step) timeseries[(row)*numCols*size + (col)*size + (step)]
-#define TMP_S(row,step) tmp_s[(row)*size + (step)]
-	// set last entry as velocity
-	for (int i = 0; i < 3; i++) {
-		velocity_history[(((size + offset) % size) + size) % size][i] = body->GetPos_dt()[i];
-		velocity_history[(((size + offset) % size) + size) % size][i + 3] = body->GetWvel_par()[i];
-	}
-	int vi;
-	//#pragma omp parallel for
-	for (int row = 0; row < numRows; row++) {
-		force_radiation_damping[row] = 0.0;
-		double fDampingCol = 0.0;
-		//#pragma omp parallel for
-		for (int col = 0; col < numCols; col++) {
-			for (int st = 0; st < size; st++) {
-				TMP_S(row, st) = 0;
-				vi = (((st + offset) % size) + size) % size; // vi takes care of circshift function from matLab
-				TIMESERIES(row, col, st) = file_info.GetRIRFval(row, col, st) * velocity_history[vi][col]; // TODO: potential issue here, col goes up to 12 now, but velocity_history is vector of 6d vectors ISSUE
-				TMP_S(row, st) += TIMESERIES(row, col, st);
-				if (st > 0) {
-					force_radiation_damping[row] -= (TMP_S(row, st - 1) + TMP_S(row, st)) / 2.0 * (rirf_time_vector[st] - rirf_time_vector[st - 1ull]);
-				}
-			}
+const ChVectorDynamic<double>& HydroForces::ComputeForceRadiationDamping(const std::vector<HydroBodyState>& states) {
+	HYDRO_PROFILE_COUNT(profile.radiation_calls);
+	HYDRO_PROFILE_TIME(profile.radiation_ns);
+	for (int b = 0; b < GetNumBodies(); b++) {
+		for (int i = 0; i < 3; i++) {
+			radiation_velocity[rirf_col_offset[b] + i] = states[b].vel[i];
+			radiation_velocity[rirf_col_offset[b] + i + 3] = states[b].wvel[i];
 		}
 	}
-	// Deallocate memory
-#undef TIMESERIES
-#undef TMP_S
-	delete[] timeseries;
-	delete[] tmp_s;
+	if (hydro_inputs.GetRadiationMode() == RadiationMode::STATE_SPACE) {
+		return ComputeForceRadiationDampingStateSpace(states);
+	}
+	return ComputeForceRadiationDampingConv(states);
+}
+
+/*******************************************************************************
+* HydroForces::ComputeForceRadiationDampingConv()
+* the first evaluation at a new time pushes the velocities of all DOFs into the
+* shared convolution history, further evaluations at that time overwrite the
+* newest sample, then the coupled radiation damping force is evaluated from the
+* RIRF (see RadiationConvolution)
+*******************************************************************************/
+const ChVectorDynamic<double>& HydroForces::ComputeForceRadiationDampingConv(const std::vector<HydroBodyState>& states) {
+	if (states[0].time != velocity_history_time) {
+		// "shift" everything left 1
+		radiation_convolution.Advance();
+		velocity_history_time = states[0].time;
+		HYDRO_PROFILE_COUNT(profile.history_advances);
+	}
+	else {
+		HYDRO_PROFILE_COUNT(profile.history_overwrites);
+	}
+	for (int col = 0; col < radiation_convolution.GetNumCols(); col++) {
+		radiation_convolution.SetVelocity(col, radiation_velocity[col]);
+	}
+	radiation_convolution.Compute(force_radiation_damping.data());
 	return force_radiation_damping;
 }
 
 /*******************************************************************************
-* HydroForces::ComputeForceExcitationRegularFreq()
-*
+* HydroForces::ComputeForceRadiationDampingStateSpace()
+* coupled radiation damping force from the state space approximation of the RIRF
+* (see RadiationStateSpace), throws std::runtime_error for a time before the
+* last accepted step, the model can't roll back that far
+*******************************************************************************/
+const ChVectorDynamic<double>& HydroForces::ComputeForceRadiationDampingStateSpace(const std::vector<HydroBodyState>& states) {
+	if (!radiation_state_space.Compute(states[0].time, radiation_velocity.data(), force_radiation_damping.data())) {
+		throw std::runtime_error("state space radiation evaluated at t = " + std::to_string(states[0].time)
+			+ " s, before its last accepted step, restore a checkpoint to go back in time");
+	}
+	return force_radiation_damping;
+}
+
+/*******************************************************************************
+* HydroForces::ComputeForceExcitation()
+* wave excitation force on all bodies for the wave type HydroInputs selected,
+* scaled by the cosine ramp 0.5 (1 - cos(pi t / T)) during the first
+* excitation ramp time T seconds of the simulation
 *******************************************************************************/
-ChVectorN<double, 6> HydroForces::ComputeForceExcitationRegularFreq() {
-	// TODO move this check for all ComputForce type functions to just before they are called?
-	if (body->GetChTime() == previous_time_ex) {
-		return force_excitation_freq;
+const ChVectorDynamic<double>& HydroForces::ComputeForceExcitation(const std::vector<HydroBodyState>& states) {
+	HYDRO_PROFILE_COUNT(profile.excitation_calls);
+	HYDRO_PROFILE_TIME(profile.excitation_ns);
+	switch (hydro_inputs.GetWaveMode()) {
+	case WaveMode::REGULAR:
+		for (int b = 0; b < GetNumBodies(); b++) {
+			force_excitation.segment<6>(6 * b) = ComputeForceExcitationRegularFreq(b, states[b]);
+		}
+		break;
+	case WaveMode::IRREGULAR:
+		ComputeForceExcitationIrregular(states);
+		break;
+	default:
+		force_excitation.setZero();
+		break;
+	}
+	double ramp_time = hydro_inputs.GetExcitationRampTime();
+	if (states[0].time < ramp_time) {
+		const double pi = 3.14159265358979323846;
+		force_excitation *= 0.5 * (1.0 - cos(pi * std::max(states[0].time, 0.0) / ramp_time));
 	}
-	previous_time_ex = body->GetChTime();
+	return force_excitation;
+}
+
+/*******************************************************************************
+* HydroForces::ComputeForceExcitationRegularFreq()
+* regular wave excitation force on all 6 DOFs of the b-th body from the complex
+* excitation coefficients at the wave frequency and heading
+*******************************************************************************/
+ChVectorN<double, 6> HydroForces::ComputeForceExcitationRegularFreq(int b, const HydroBodyState& state) {
+	// F = Re(A X e^(i w t)), one rotation shared by the body's 6 DOFs
+	double rotation_re = cos(wave_omega * state.time);
+	double rotation_im = sin(wave_omega * state.time);
+	ChVectorN<double, 6> force_excitation_freq;
 	for (int rowEx = 0; rowEx < 6; rowEx++) {
-		if (rowEx == 2) {
-			force_excitation_freq[rowEx] = excitation_force_mag[rowEx] * wave_amplitude * cos(wave_omega * body->GetChTime() + excitation_force_phase[rowEx]);
+		force_excitation_freq[rowEx] = excitation_force_re[6 * b + rowEx] * rotation_re - excitation_force_im[6 * b + rowEx] * rotation_im;
+	}
+	return force_excitation_freq;
+}
+
+/*******************************************************************************
+* HydroForces::ComputeForceExcitationIrregular()
+* irregular wave excitation force on all 6 DOFs of every body from the spectral
+* components set up at construction, read from the precomputed time series
+* (see ExcitationTimeSeries) or summed at this time (see IrregularWaveExcitation)
+*******************************************************************************/
+const ChVectorDynamic<double>& HydroForces::ComputeForceExcitationIrregular(const std::vector<HydroBodyState>& states) {
+	if (excitation_time_series.GetNumSamples() > 0) {
+		excitation_time_series.Compute(states[0].time, force_excitation.data());
+		return force_excitation;
+	}
+	irregular_excitation.Compute(states[0].time, force_excitation.data());
+	return force_excitation;
+}
+
+/*******************************************************************************
+* HydroForces::IsProfilingEnabled()
+* true if the library was built with HYDROCHRONO_PROFILE, otherwise all
+* profile counters stay zero
+*******************************************************************************/
+bool HydroForces::IsProfilingEnabled() {
+#ifdef HYDROCHRONO_PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*******************************************************************************
+* HydroForces::ResetProfile()
+* zeroes all counters, the memory held by the force models is kept
+*******************************************************************************/
+void HydroForces::ResetProfile() {
+	profile = HydroProfile();
+	profile.bytes_allocated = radiation_convolution.GetNumBytes() + radiation_state_space.GetNumBytes() + irregular_excitation.GetNumBytes()
+		+ (excitation_time_series.IsFileBacked() ? 0 : excitation_time_series.GetNumBytes());
+	for (const NonlinearHydrostatics& mesh : nonlinear_hydrostatics) {
+		profile.bytes_allocated += mesh.GetNumBytes();
+	}
+	for (HydroProfile& body : body_profile) {
+		body = HydroProfile();
+	}
+}
+
+/*******************************************************************************
+* HydroForces::GetProfile()
+* counters of all bodies together
+*******************************************************************************/
+HydroProfile HydroForces::GetProfile() const {
+	HydroProfile total = profile;
+	for (const HydroProfile& body : body_profile) {
+		total.hydrostatics_calls += body.hydrostatics_calls;
+		total.hydrostatics_ns += body.hydrostatics_ns;
+	}
+	return total;
+}
+
+/*******************************************************************************
+* HydroForces::GetProfile(int b)
+* counters of the b-th body. Radiation and excitation are evaluated for all
+* bodies at once, every body gets an equal share of their time and memory
+*******************************************************************************/
+HydroProfile HydroForces::GetProfile(int b) const {
+	HydroProfile body = profile;
+	body.hydrostatics_calls = body_profile[b].hydrostatics_calls;
+	body.hydrostatics_ns = body_profile[b].hydrostatics_ns;
+	body.radiation_ns /= GetNumBodies();
+	body.excitation_ns /= GetNumBodies();
+	body.bytes_allocated /= GetNumBodies();
+	return body;
+}
+
+/*******************************************************************************
+* HydroForces::PrintProfile()
+* writes a summary of the counters of every body and the total to out
+*******************************************************************************/
+void HydroForces::PrintProfile(std::ostream& out) const {
+	if (!IsProfilingEnabled()) {
+		out << "hydro force profile not available, build with HYDROCHRONO_PROFILE\n";
+		return;
+	}
+	auto print = [&out](const std::string& name, const HydroProfile& p) {
+		out << name << ": " << p.force_calls << " force calls (" << p.force_cache_hits << " cached), "
+			<< p.history_advances << " history steps (" << p.history_overwrites << " overwrites), "
+			<< "hydrostatics " << p.hydrostatics_ns * 1e-6 << " ms, radiation " << p.radiation_ns * 1e-6 << " ms, excitation "
+			<< p.excitation_ns * 1e-6 << " ms, " << p.bytes_allocated / 1024.0 << " KB\n";
+	};
+	for (int b = 0; b < GetNumBodies(); b++) {
+		print("body " + std::to_string(b + 1), GetProfile(b));
+	}
+	print("total", GetProfile());
+}
+
+/*******************************************************************************
+* HydroForces::PrintReport()
+* writes what the constructor noted about the setup (fallbacks, mesh and
+* excitation sizes, RIRF resampling), the size of the radiation model and the
+* coupling report to out, nothing is printed while constructing
+*******************************************************************************/
+void HydroForces::PrintReport(std::ostream& out) const {
+	out << setup_messages;
+	if (hydro_inputs.GetRadiationMode() == RadiationMode::STATE_SPACE) {
+		radiation_state_space.PrintFitReport(out);
+	}
+	else {
+		radiation_convolution.PrintReport(out);
+	}
+	PrintCouplingReport(out);
+}
+
+/*******************************************************************************
+* HydroForces::PrintCouplingReport()
+* nonzero entries of every body's h5 coefficients out of all entries, the
+* force terms only visit the nonzero ones. Excitation counts (DOF, heading) pairs
+*******************************************************************************/
+void HydroForces::PrintCouplingReport(std::ostream& out) const {
+	long long nonzeros = 0;
+	long long entries = 0;
+	for (int b = 0; b < GetNumBodies(); b++) {
+		const char* names[4] = { "stiffness", "added mass", "RIRF", "excitation" };
+		const CouplingPattern* patterns[4] = { &file_info[b]->GetHydrostaticStiffnessPattern(), &file_info[b]->GetInfAddedMassPattern(),
+			&file_info[b]->GetRIRFPattern(), &file_info[b]->GetExcitationPattern() };
+		out << "coupling body " << b + 1 << " nonzero entries:";
+		for (int i = 0; i < 4; i++) {
+			out << (i > 0 ? ", " : " ") << names[i] << " " << patterns[i]->GetNumNonzeros() << " of " << patterns[i]->GetNumRows() * patterns[i]->GetNumCols();
+			nonzeros += patterns[i]->GetNumNonzeros();
+			entries += patterns[i]->GetNumRows() * patterns[i]->GetNumCols();
 		}
-		else {
-			force_excitation_freq[rowEx] = 0.0;
+		out << "\n";
+	}
+	out << "coupling total: " << nonzeros << " of " << entries << " entries (" << (entries > 0 ? 100.0 * nonzeros / entries : 0.0) << "%)\n";
+}
+
+namespace {
+	const int kBodyStateValues = 14;
+
+	/*******************************************************************************
+	* WriteBodyState()
+	* time, position, rotation quaternion, velocity and angular velocity as one
+	* array of doubles
+	*******************************************************************************/
+	void WriteBodyState(StateWriter& out, const HydroBodyState& state) {
+		double vals[kBodyStateValues] = { state.time, state.pos.x(), state.pos.y(), state.pos.z(), state.rot.e0(), state.rot.e1(), state.rot.e2(), state.rot.e3(),
+			state.vel.x(), state.vel.y(), state.vel.z(), state.wvel.x(), state.wvel.y(), state.wvel.z() };
+		out.WriteArray(vals, kBodyStateValues);
+	}
+
+	/*******************************************************************************
+	* ReadBodyState()
+	* reads a state written by WriteBodyState()
+	*******************************************************************************/
+	bool ReadBodyState(StateReader& in, HydroBodyState& state) {
+		double vals[kBodyStateValues];
+		if (!in.ReadArray(vals, kBodyStateValues)) {
+			return false;
 		}
+		state.time = vals[0];
+		state.pos = ChVector<>(vals[1], vals[2], vals[3]);
+		state.rot = ChQuaternion<>(vals[4], vals[5], vals[6], vals[7]);
+		state.vel = ChVector<>(vals[8], vals[9], vals[10]);
+		state.wvel = ChVector<>(vals[11], vals[12], vals[13]);
+		return true;
+	}
+}
+
+/*******************************************************************************
+* HydroForces::SetBodyState()
+* moves the b-th ChBody to state and sets its system's time to state.time
+*******************************************************************************/
+void HydroForces::SetBodyState(int b, const HydroBodyState& state) {
+	bodies[b]->SetPos(state.pos);
+	bodies[b]->SetRot(state.rot);
+	bodies[b]->SetPos_dt(state.vel);
+	bodies[b]->SetWvel_par(state.wvel);
+	if (bodies[b]->GetSystem() != nullptr) {
+		bodies[b]->GetSystem()->SetChTime(state.time);
 	}
-	return force_excitation_freq;
 }
 
 /*******************************************************************************
-* HydroForces::coordinateFunc
-* if index is in [0,6] the corresponding vector component of the force vector
-* is returned
-* otherwise a warning is printed and the force is interpreted to be 0
+* HydroForces::WarmStart()
+* starts a regular wave run from the linear steady state instead of from rest.
+* linear_model (same h5 data, masses and linear PTOs or moorings as the Chrono
+* system) is solved at the wave frequency, the bodies are moved to that
+* response x(t) = Re(A X e^(i w t)) at their current time (rotations as small
+* Euler angles about the equilibrium, as in the linear hydrostatics), and the
+* radiation history is filled with the velocities they had over the whole RIRF
+* length (state space: the modes' steady state). Only the transients of what
+* the linear model leaves out remain.
+* returns false, changing nothing, unless the wave is regular, linear_model
+* has the same DOFs and wave heading, and any excitation ramp is over by the
+* bodies' current time (the steady state assumes the full excitation)
 *******************************************************************************/
-double HydroForces::coordinateFunc(int i) {
-	if (i >= 0 && i < 6) {
-		// TODO put timestep check here? maybe 
-		double f_hydrostatic = ComputeForceHydrostatics()[i];
-		double f_radiation_damping = ComputeForceRadiationDampingConv()[i];
-		double f_excitation_freq = ComputeForceExcitationRegularFreq()[i];
-		double total_force = f_hydrostatic + f_radiation_damping + f_excitation_freq;
-		return total_force;
+bool HydroForces::WarmStart(const FrequencyDomainSolver& linear_model) {
+	int num_dofs = 6 * GetNumBodies();
+	if (hydro_inputs.GetWaveMode() != WaveMode::REGULAR || linear_model.GetNumDofs() != num_dofs || num_dofs == 0 ||
+		linear_model.GetWaveHeading() != hydro_inputs.GetWaveHeading()) {
+		return false;
+	}
+	double time = GetBodyState(0).time;
+	if (time < hydro_inputs.GetExcitationRampTime()) {
+		return false;
+	}
+	FrequencyResponse response = linear_model.Solve({ wave_omega });
+	std::complex<double> rotation = std::exp(std::complex<double>(0.0, wave_omega * time));
+	std::vector<std::complex<double>> velocity_amplitude(radiation_velocity.size(), 0.0);
+	for (int b = 0; b < GetNumBodies(); b++) {
+		double x[6];
+		double v[6];
+		for (int d = 0; d < 6; d++) {
+			std::complex<double> amplitude = wave_amplitude * response.GetRAO(0, 6 * b + d);
+			x[d] = (amplitude * rotation).real();
+			v[d] = (std::complex<double>(0.0, wave_omega) * amplitude * rotation).real();
+			velocity_amplitude[rirf_col_offset[b] + d] = std::complex<double>(0.0, wave_omega) * amplitude;
+		}
+		HydroBodyState state;
+		state.time = time;
+		state.pos = ChVector<>(equilibrium[6 * b] + x[0], equilibrium[6 * b + 1] + x[1], equilibrium[6 * b + 2] + x[2]);
+		state.rot = Q_from_Euler123(ChVector<>(x[3], x[4], x[5]));
+		state.vel = ChVector<>(v[0], v[1], v[2]);
+		state.wvel = ChVector<>(v[3], v[4], v[5]);
+		SetBodyState(b, state);
+	}
+
+	if (hydro_inputs.GetRadiationMode() == RadiationMode::STATE_SPACE) {
+		radiation_state_space.SetHarmonicState(time, wave_omega, velocity_amplitude.data());
 	}
 	else {
-		std::cout << "wrong index" << std::endl;
-		return 0;
+		// the history holds one sample per radiation time step, newest at time
+		double dt = hydro_inputs.GetRadiationTimeStep() > 0.0 ? hydro_inputs.GetRadiationTimeStep() : file_info[0]->GetRIRFdt();
+		for (int col = 0; col < radiation_convolution.GetNumCols(); col++) {
+			for (int st = 0; st < radiation_convolution.GetNumSteps(); st++) {
+				std::complex<double> past_rotation = std::exp(std::complex<double>(0.0, wave_omega * (time - st * dt)));
+				radiation_convolution.SetPastVelocity(col, st, (velocity_amplitude[col] * past_rotation).real());
+			}
+		}
+		velocity_history_time = time;
 	}
+	has_cached_state = false;
+	return true;
 }
 
 /*******************************************************************************
-* HydroForces::SetForce
-* used to initialize components of force (external ChForce pointer)
+* HydroForces::SaveState()
+* appends everything the following force evaluations depend on to out: the
+* bodies' current states, the cached force vectors and the states they were
+* computed for, the convolution history (or state space modes), the irregular
+* wave phasors and the nonlinear hydrostatics block sums. Coefficients built at
+* construction from the h5 file and HydroInputs are not saved
 *******************************************************************************/
-void HydroForces::SetForce() {
-	chrono_force->SetF_x(force_ptrs[0]);
-	chrono_force->SetF_y(force_ptrs[1]);
-	chrono_force->SetF_z(force_ptrs[2]);
-	body->AddForce(chrono_force);
+void HydroForces::SaveState(StateWriter& out) const {
+	out.Write((int32_t)GetNumBodies());
+	out.Write((int32_t)hydro_inputs.GetRadiationMode());
+	out.Write((int32_t)hydro_inputs.GetWaveMode());
+	for (int b = 0; b < GetNumBodies(); b++) {
+		WriteBodyState(out, GetBodyState(b));
+	}
+	out.Write(has_cached_state);
+	for (const HydroBodyState& state : cached_states) {
+		WriteBodyState(out, state);
+	}
+	out.WriteArray(force_radiation_damping.data(), (size_t)force_radiation_damping.size());
+	out.WriteArray(force_excitation.data(), (size_t)force_excitation.size());
+	out.WriteArray(force_total.data(), (size_t)force_total.size());
+	out.Write(velocity_history_time);
+	out.Write(radiation_velocity);
+	radiation_convolution.SaveState(out);
+	radiation_state_space.SaveState(out);
+	irregular_excitation.SaveState(out);
+	out.Write((int32_t)nonlinear_hydrostatics.size());
+	for (const NonlinearHydrostatics& mesh : nonlinear_hydrostatics) {
+		mesh.SaveState(out);
+	}
 }
 
 /*******************************************************************************
-* HydroForces::SetTorque
-* used to initialize components of torque (external ChForce pointer with TORQUE flag set)
+* HydroForces::RestoreState()
+* reads back what SaveState() wrote, so the next steps give bitwise the same
+* forces as they would have without the restart. With restore_bodies the
+* ChBody objects and the system time are set back to the saved states too,
+* the rest of the Chrono system (links, solver) is up to the caller
+* returns false if in was saved by a different model setup (bodies, modes,
+* RIRF length, wave components, meshes), the state is undefined then
 *******************************************************************************/
-void HydroForces::SetTorque() {
-	chrono_torque->SetF_x(force_ptrs[3]);
-	chrono_torque->SetF_y(force_ptrs[4]);
-	chrono_torque->SetF_z(force_ptrs[5]);
-	chrono_torque->SetMode(ChForce::ForceType::TORQUE);
-	body->AddForce(chrono_torque);
+bool HydroForces::RestoreState(StateReader& in, bool restore_bodies) {
+	int32_t num_bodies = 0;
+	int32_t radiation_mode = 0;
+	int32_t wave_mode = 0;
+	if (!in.Read(num_bodies) || !in.Read(radiation_mode) || !in.Read(wave_mode) || num_bodies != GetNumBodies()
+		|| radiation_mode != (int32_t)hydro_inputs.GetRadiationMode() || wave_mode != (int32_t)hydro_inputs.GetWaveMode()) {
+		return false;
+	}
+	std::vector<HydroBodyState> body_states(num_bodies);
+	for (HydroBodyState& state : body_states) {
+		if (!ReadBodyState(in, state)) {
+			return false;
+		}
+	}
+	if (!in.Read(has_cached_state)) {
+		return false;
+	}
+	for (HydroBodyState& state : cached_states) {
+		if (!ReadBodyState(in, state)) {
+			return false;
+		}
+	}
+	int32_t num_meshes = 0;
+	if (!in.ReadArray(force_radiation_damping.data(), (size_t)force_radiation_damping.size()) || !in.ReadArray(force_excitation.data(), (size_t)force_excitation.size())
+		|| !in.ReadArray(force_total.data(), (size_t)force_total.size()) || !in.Read(velocity_history_time) || !in.Read(radiation_velocity)
+		|| !radiation_convolution.RestoreState(in) || !radiation_state_space.RestoreState(in) || !irregular_excitation.RestoreState(in)
+		|| !in.Read(num_meshes) || num_meshes != (int32_t)nonlinear_hydrostatics.size()) {
+		return false;
+	}
+	for (NonlinearHydrostatics& mesh : nonlinear_hydrostatics) {
+		if (!mesh.RestoreState(in)) {
+			return false;
+		}
+	}
+	if (!in.IsAtEnd()) {
+		return false;
+	}
+	// the checkpoint only holds the total and two of its terms
+	force_hydrostatics = force_total - force_radiation_damping - force_excitation;
+	if (restore_bodies) {
+		for (int b = 0; b < num_bodies; b++) {
+			SetBodyState(b, body_states[b]);
+		}
+	}
+	return true;
 }
 
 // =============================================================================
@@ -709,40 +1743,91 @@ std::vector<std::shared_ptr<ChLoadable>> constructorHelper(std::vector<std::shar
 	return re;
 }
 
+namespace {
+	/*******************************************************************************
+	* OwnAddedMassBlock()
+	* the 6x6 block of file's added mass rows belonging to its own DOFs
+	*******************************************************************************/
+	ChMatrixDynamic<double> OwnAddedMassBlock(const H5FileInfo& file) {
+		const ChMatrixDynamic<double>& rows = file.GetInfAddedMassMatrix();
+		int col = rows.cols() > 6 ? 6 * (file.GetBodyNumber() - 1) : 0;
+		if (rows.rows() < 6 || col + 6 > rows.cols()) {
+			return rows;
+		}
+		return rows.block<6, 6>(0, col);
+	}
+}
+
+/*******************************************************************************
+* ChLoadAddedMass::BuildAddedMassMatrix()
+* stacks the bodies' infinite frequency added mass rows (scaled by rho) into one
+* 6N x 6N matrix. Coupled files (6 x 6M) give every body pair's block, taking
+* body j's columns from its body number, uncoupled files (6 x 6) only the
+* diagonal blocks. Rows too short for that throw std::invalid_argument
+*******************************************************************************/
+ChMatrixDynamic<double> ChLoadAddedMass::BuildAddedMassMatrix(const std::vector<std::shared_ptr<const H5FileInfo>>& file_infos) {
+	int num_bodies = (int)file_infos.size();
+	ChMatrixDynamic<double> added_mass;
+	added_mass.setZero(6 * num_bodies, 6 * num_bodies);
+	for (int i = 0; i < num_bodies; i++) {
+		const ChMatrixDynamic<double>& rows = file_infos[i]->GetInfAddedMassMatrix();
+		if (rows.rows() < 6) {
+			throw std::invalid_argument("added mass of body " + std::to_string(i + 1) + " has " + std::to_string(rows.rows()) + " rows, expected 6");
+		}
+		for (int j = 0; j < num_bodies; j++) {
+			int col = rows.cols() > 6 ? 6 * (file_infos[j]->GetBodyNumber() - 1) : (i == j ? 0 : -1);
+			if (col < 0) {
+				continue;
+			}
+			if (col + 6 > rows.cols()) {
+				throw std::invalid_argument("added mass of body " + std::to_string(i + 1) + " has " + std::to_string(rows.cols())
+					+ " columns, too few for body " + std::to_string(j + 1));
+			}
+			added_mass.block<6, 6>(6 * i, 6 * j) = rows.block<6, 6>(0, col);
+		}
+	}
+	return added_mass;
+}
+
+/*******************************************************************************
+* ChLoadAddedMass constructor
+* added mass of all bodies, coupled through the off diagonal blocks if the h5
+* file has them
+*******************************************************************************/
+ChLoadAddedMass::ChLoadAddedMass(const std::vector<std::shared_ptr<const H5FileInfo>>& file_infos,
+	std::vector<std::shared_ptr<ChBody>>& bodies)
+	: ChLoadAddedMass(BuildAddedMassMatrix(file_infos), bodies) {}
+
 /*******************************************************************************
 * ChLoadAddedMass constructor
 * initializes body to have load applied to and added mass matrix from h5 file object
 *******************************************************************************/
 ChLoadAddedMass::ChLoadAddedMass(const H5FileInfo& file, 
 	std::vector<std::shared_ptr<ChBody>>& bodies) 
-	: ChLoadCustomMultiple(constructorHelper(bodies)) { ///< calls ChLoadCustomMultiple to link loads to bodies
-	inf_added_mass_J = file.GetInfAddedMassMatrix(); //TODO switch all uses of H5FileInfo object to be like this, instead of copying the object each time?
+	: ChLoadAddedMass(OwnAddedMassBlock(file), bodies) {}
 
-	std::ofstream myfile;
-	//myfile.open("C:\\code\\chrono_hydro_dev\\HydroChrono_build\\Release\\inf_added_mass_J.txt");
-	myfile.open("inf_added_mass_J_txt");
-	myfile << inf_added_mass_J << "\n";
-	myfile.close();
-}
 /*******************************************************************************
 * ChLoadAddedMass constructor
-* initializes body to have load applied to and added mass matrix from h5 file object
+* initializes bodies to have load applied to and the 6N x 6N added mass matrix,
+* a matrix of another size throws std::invalid_argument
 *******************************************************************************/
 ChLoadAddedMass::ChLoadAddedMass(const ChMatrixDynamic<>& addedMassMatrix,
 	std::vector<std::shared_ptr<ChBody>>& bodies)
-	: ChLoadCustomMultiple(constructorHelper(bodies)) { ///< calls ChLoadCustomMultiple to link loads to bodies
-	inf_added_mass_J = addedMassMatrix; //TODO switch all uses of H5FileInfo object to be like this, instead of copying the object each time?
-
-	std::ofstream myfile;
-	//myfile.open("C:\\code\\chrono_hydro_dev\\HydroChrono_build\\Release\\inf_added_mass_J.txt");
-	myfile.open("inf_added_mass_J_txt");
-	myfile << inf_added_mass_J << "\n";
-	myfile.close();
+	: ChLoadCustomMultiple(constructorHelper(bodies)), jacobian_filled(nullptr) { ///< calls ChLoadCustomMultiple to link loads to bodies
+	inf_added_mass_J = addedMassMatrix;
+	if (inf_added_mass_J.rows() != 6 * (int)bodies.size() || inf_added_mass_J.cols() != 6 * (int)bodies.size()) {
+		throw std::invalid_argument("added mass matrix is " + std::to_string(inf_added_mass_J.rows()) + " x " + std::to_string(inf_added_mass_J.cols())
+			+ ", expected " + std::to_string(6 * bodies.size()) + " x " + std::to_string(6 * bodies.size()));
+	}
+	Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> row_major = inf_added_mass_J;
+	added_mass_pattern = CouplingPattern((int)row_major.rows(), (int)row_major.cols(), row_major.data());
 }
+
 /*******************************************************************************
 * ChLoadAddedMass::ComputeJacobian()
 * Computes Jacobian for load, in this case just the mass matrix is initialized
-* as the added mass matrix
+* as the added mass matrix. It doesn't depend on the state, so it's only
+* written the first time (or when Chrono hands over new Jacobian storage)
 *******************************************************************************/
 void ChLoadAddedMass::ComputeJacobian(ChState* state_x,       ///< state position to evaluate jacobians
 	ChStateDelta* state_w,  ///< state speed to evaluate jacobians
@@ -750,58 +1835,148 @@ void ChLoadAddedMass::ComputeJacobian(ChState* state_x,       ///< state positio
 	ChMatrixRef mR,         ///< result dQ/dv
 	ChMatrixRef mM          ///< result dQ/da
 ) {
+	if (jacobian_filled == jacobians) {
+		return;
+	}
 	//set mass matrix here
-
-	jacobians->M = inf_added_mass_J;
-
-	ChMatrixDynamic<double> massmat = jacobians->M;
-
-	std::ofstream myfile2;
-	//myfile2.open("C:\\code\\chrono_hydro_dev\\HydroChrono_build\\Release\\massmat.txt");
-	myfile2.open("massmat.txt");
-	myfile2 << massmat << "\n";
-	myfile2.close();
+	mM = inf_added_mass_J;
 
 	// R gyroscopic damping matrix terms (6x6)
 	// 0 for added mass
-	jacobians->R.setZero();
+	mR.setZero();
 
 	// K inertial stiffness matrix terms (6x6)
 	// 0 for added mass
-	jacobians->K.setZero();
+	mK.setZero();
+	jacobian_filled = jacobians;
 }
 
 /*******************************************************************************
 * ChLoadAddedMass::LoadIntLoadResidual_Mv()
 * Computes LoadIntLoadResidual_Mv for vector w, const c, and vector R
 * Note R here is vector, and is not R gyroscopic damping matrix from ComputeJacobian
+* R and w are the system wide vectors, body i's 6 speeds start at its loadable's
+* offset, so R_i += c * M_ij * w_j over the nonzero entries of M only
 *******************************************************************************/
 void ChLoadAddedMass::LoadIntLoadResidual_Mv(ChVectorDynamic<>& R, const ChVectorDynamic<>& w, const double c) {
-	if (!this->jacobians)
-		return;
+	for (int row = 0; row < added_mass_pattern.GetNumRows(); row++) {
+		ChLoadable* row_body = loadables[row / 6].get();
+		if (!row_body->IsSubBlockActive(0)) {
+			continue;
+		}
+		double sum = 0.0;
+		for (int entry = added_mass_pattern.GetRowStart(row); entry < added_mass_pattern.GetRowStart(row + 1); entry++) {
+			int col = added_mass_pattern.GetCol(entry);
+			ChLoadable* col_body = loadables[col / 6].get();
+			if (col_body->IsSubBlockActive(0)) {
+				sum += added_mass_pattern.GetValue(entry) * w[col_body->GetSubBlockOffset(0) + col % 6];
+			}
+		}
+		R[row_body->GetSubBlockOffset(0) + row % 6] += c * sum;
+	}
+}
 
-	//if (!loadable->IsSubBlockActive(0))
-	//	return;
+// =============================================================================
+// ChLoadHydroForces Class Definitions
+// =============================================================================
 
-	// R+=c*M*a
-	// segment gives the chunk of vector starting at the first argument, and going for as many elements as the second argument...
-	// in this case, segment gets the 3vector starting at the 0th DOF's offset (ie 0)
-	//R.segment(loadable->GetSubBlockOffset(0), 3) += c * (this->mass * (a_x + chrono::Vcross(a_w, this->c_m))).eigen();
-	// in this case, segment gets the 3vector starting at the 0th DOF's + 3 offset (ie 3)
-	//R.segment(loadable->GetSubBlockOffset(0) + 3, 3) += c * (this->mass * chrono::Vcross(this->c_m, a_x) + this->I * a_w).eigen();
-	// since R is a vector, we can probably just do R += C*M*a with no need to separate w into a_x and a_w above
-	R += c * jacobians->M * w;
+/*******************************************************************************
+* ChLoadHydroForces constructor
+* links the load to the bodies HydroForces computes forces for
+*******************************************************************************/
+ChLoadHydroForces::ChLoadHydroForces(HydroForces* hydro_forces,
+	std::vector<std::shared_ptr<ChBody>>& bodies)
+	: ChLoadCustomMultiple(constructorHelper(bodies)), base(hydro_forces), states(bodies.size()) {}
+
+/*******************************************************************************
+* ChLoadHydroForces::ComputeQ()
+* builds each body's state from state_x (position, rotation quaternion, 7 per
+* body) and state_w (absolute linear velocity, local angular velocity, 6 per
+* body), or reads it from the bodies if they are null, and evaluates the full
+* hydro force vector once.
+* Q holds each body's force in the absolute frame and torque in the body frame
+*******************************************************************************/
+void ChLoadHydroForces::ComputeQ(ChState* state_x, ChStateDelta* state_w) {
+	for (int b = 0; b < (int)states.size(); b++) {
+		states[b] = base->GetBodyState(b);
+		if (state_x) {
+			int ix = 7 * b;
+			states[b].pos = ChVector<>((*state_x)(ix), (*state_x)(ix + 1), (*state_x)(ix + 2));
+			states[b].rot = ChQuaternion<>((*state_x)(ix + 3), (*state_x)(ix + 4), (*state_x)(ix + 5), (*state_x)(ix + 6));
+		}
+		if (state_w) {
+			int iw = 6 * b;
+			states[b].vel = ChVector<>((*state_w)(iw), (*state_w)(iw + 1), (*state_w)(iw + 2));
+			states[b].wvel = states[b].rot.Rotate(ChVector<>((*state_w)(iw + 3), (*state_w)(iw + 4), (*state_w)(iw + 5)));
+		}
+	}
+	const ChVectorDynamic<double>& force = base->ComputeForce(states);
+	for (int b = 0; b < (int)states.size(); b++) {
+		ChVector<> torque_local = states[b].rot.RotateBack(ChVector<>(force[6 * b + 3], force[6 * b + 4], force[6 * b + 5]));
+		load_Q.segment(6 * b, 3) = force.segment(6 * b, 3);
+		load_Q.segment(6 * b + 3, 3) = torque_local.eigen();
+	}
 }
 
 // =============================================================================
 // LoadAllHydroForces Class Definitions
 // =============================================================================
+
 /*******************************************************************************
-*
+* LoadAllHydroForces constructor
+* reads body_name's section of the h5 file and applies the hydro forces to object
+* through a ChLoadHydroForces and its infinite frequency added mass through a
+* ChLoadAddedMass, both in a load container added to object's system
 *******************************************************************************/
 LoadAllHydroForces::LoadAllHydroForces(std::shared_ptr<ChBody> object, std::string file, std::string bodyName, HydroInputs user_hydro_inputs) :
-	sys_file_info(file, bodyName), hydro_force(sys_file_info, object, user_hydro_inputs) {
-	std::cout << "bodyName = (" << bodyName << ")" << std::endl;
-	hydro_force.SetForce();
-	hydro_force.SetTorque();
+	LoadAllHydroForces(std::vector<std::shared_ptr<ChBody>>{ object }, std::vector<std::string>{ bodyName }, file, user_hydro_inputs) {}
+
+/*******************************************************************************
+* LoadAllHydroForces constructor
+* for several bodies described in one h5 file, objects[i] is read from section
+* "body<i+1>", so the bodies must be given in the h5 file's order. Their
+* radiation forces are coupled through the full 6N x 6N RIRF
+*******************************************************************************/
+LoadAllHydroForces::LoadAllHydroForces(std::vector<std::shared_ptr<ChBody>> objects, std::string file, HydroInputs user_hydro_inputs) :
+	LoadAllHydroForces(objects, DefaultBodyNames(objects.size()), file, user_hydro_inputs) {}
+
+/*******************************************************************************
+* LoadAllHydroForces constructor
+* common implementation of the public constructors, body_names[i] is the h5
+* section of objects[i]. The bodies must already be added to their system
+*******************************************************************************/
+LoadAllHydroForces::LoadAllHydroForces(std::vector<std::shared_ptr<ChBody>> objects, std::vector<std::string> body_names, std::string file, HydroInputs user_hydro_inputs) :
+	sys_file_info(ReadFileInfos(file, body_names)), hydro_force(sys_file_info, objects, user_hydro_inputs) {
+	// one load evaluates all components of all bodies together
+	my_hydro_load = chrono_types::make_shared<ChLoadHydroForces>(&hydro_force, objects);
+	// infinite frequency added mass, the convolution above only holds the memory part of the radiation force
+	my_added_mass_load = chrono_types::make_shared<ChLoadAddedMass>(sys_file_info, objects);
+	my_loadcontainer = chrono_types::make_shared<ChLoadContainer>();
+	my_loadcontainer->Add(my_hydro_load);
+	my_loadcontainer->Add(my_added_mass_load);
+	objects[0]->GetSystem()->Add(my_loadcontainer);
+}
+
+/*******************************************************************************
+* LoadAllHydroForces::DefaultBodyNames()
+* h5 section names "body1" .. "body<num_bodies>"
+*******************************************************************************/
+std::vector<std::string> LoadAllHydroForces::DefaultBodyNames(size_t num_bodies) {
+	std::vector<std::string> names(num_bodies);
+	for (size_t i = 0; i < num_bodies; i++) {
+		names[i] = "body" + std::to_string(i + 1);
+	}
+	return names;
+}
+
+/*******************************************************************************
+* LoadAllHydroForces::ReadFileInfos()
+* one H5FileInfo per body name, from the shared cache (see H5FileInfo::Load())
+*******************************************************************************/
+std::vector<std::shared_ptr<const H5FileInfo>> LoadAllHydroForces::ReadFileInfos(std::string file, const std::vector<std::string>& body_names) {
+	std::vector<std::shared_ptr<const H5FileInfo>> infos;
+	for (const std::string& bodyName : body_names) {
+		infos.push_back(H5FileInfo::Load(file, bodyName));
+	}
+	return infos;
 }
@@ -1,4 +1,9 @@
+#pragma once
+
 #include <cstdio>
+#include <complex>
+#include <mutex>
+#include <ostream>
 
 #include "chrono/solver/ChSolverPMINRES.h"
 #include "chrono/solver/ChIterativeSolverLS.h"
@@ -20,6 +25,17 @@
 
 #include "H5Cpp.h"
 
+#include "radiation_convolution.h"
+#include "radiation_state_space.h"
+#include "wave_excitation.h"
+#include "excitation_time_series.h"
+#include "mapped_file.h"
+#include "nonlinear_hydrostatics.h"
+#include "coupling_pattern.h"
+#include "state_buffer.h"
+
+class FrequencyDomainSolver;
+
 using namespace chrono;
 using namespace chrono::irrlicht;
 using namespace chrono::fea;
@@ -29,54 +45,125 @@ class H5FileInfo {
 public:
 	H5FileInfo();
 	H5FileInfo(std::string file, std::string body_name);
+	H5FileInfo(const H5FileInfo& other) = delete;
+	H5FileInfo& operator = (const H5FileInfo& rhs) = delete;
 	~H5FileInfo();
-	ChMatrixDynamic<double> GetHydrostaticStiffnessMatrix() const;
-	ChMatrixDynamic<double> GetInfAddedMassMatrix() const;
+	static std::shared_ptr<const H5FileInfo> Load(std::string file, std::string body_name);
+	static void ClearCache();
+	static void Bake(std::string h5_file, std::string baked_file);
+	static bool IsBakedFile(std::string file);
+	const ChMatrixDynamic<double>& GetHydrostaticStiffnessMatrix() const;
+	const ChMatrixDynamic<double>& GetInfAddedMassMatrix() const;
+	const CouplingPattern& GetHydrostaticStiffnessPattern() const;
+	const CouplingPattern& GetInfAddedMassPattern() const;
+	const CouplingPattern& GetRIRFPattern() const;
+	const CouplingPattern& GetExcitationPattern() const;
 	ChVector<> GetEquilibriumCoG() const;
 	ChVector<> GetEquilibriumCoB() const;
 	double GetRho() const;
 	double GetGravity() const;
 	double GetDisplacementVolume() const;
 	double GetRIRFval(int i, int n, int m) const;
+	Eigen::Map<const ChVectorDynamic<double>> GetRIRFEntry(int i, int n) const;
 	int GetRIRFDims(int i) const;
+	double GetRadiationDampingValue(int i, int j, int k) const;
+	Eigen::Map<const ChVectorDynamic<double>> GetRadiationDampingEntry(int i, int j) const;
+	int GetRadiationDampingDims(int i) const;
+	double GetAddedMassValue(int i, int j, int k) const;
+	Eigen::Map<const ChVectorDynamic<double>> GetAddedMassEntry(int i, int j) const;
+	int GetAddedMassDims(int i) const;
 	double GetExcitationMagValue(int m, int n, int w) const;
 	double GetExcitationMagInterp(int i, int j, double freq_index_des) const;
 	double GetExcitationPhaseValue(int m, int n, int w) const;
 	double GetExcitationPhaseInterp(int i, int j, double freq_index_des) const;
+	double GetExcitationReValue(int i, int j, int k) const;
+	double GetExcitationReInterp(int i, int j, double freq_index_des) const;
+	double GetExcitationImValue(int i, int j, int k) const;
+	double GetExcitationImInterp(int i, int j, double freq_index_des) const;
+	std::complex<double> GetExcitationInterp(int i, double omega, double heading) const;
+	int GetNumWaveHeadings() const;
+	double GetWaveHeading(int j) const;
 	double GetOmegaMin() const;
 	double GetOmegaMax() const;
 	double GetOmegaDelta() const;
 	double GetRIRFdt() const;
-	std::vector<double> GetRIRFTimeVector() const;
+	const std::vector<double>& GetRIRFTimeVector() const;
+	const std::vector<double>& GetFrequencyVector() const;
 	double GetNumFreqs() const;
+	int GetBodyNumber() const;
 private:
-	ChMatrixDynamic<double> lin_matrix;
-	ChMatrixDynamic<double> inf_added_mass;
-	double* rirf_matrix;
+	ChMatrixDynamic<double> lin_matrix;                    ///< scaled by rho g
+	ChMatrixDynamic<double> inf_added_mass;                ///< scaled by rho
+	CouplingPattern hydrostatic_stiffness_pattern;         ///< nonzero entries of lin_matrix, with their values
+	CouplingPattern inf_added_mass_pattern;                ///< nonzero entries of inf_added_mass, with their values
+	CouplingPattern excitation_pattern;                    ///< (row, wave heading) pairs with nonzero excitation at any frequency
+	mutable CouplingPattern rirf_pattern;                  ///< (row, col) pairs with a nonzero RIRF, set in LoadRIRF()
+	// coefficient arrays, already scaled by rho (radiation) or rho g (excitation),
+	// pointing into the *_storage vectors (h5 file) or into the mapped baked file
+	mutable const double* rirf_matrix;                     ///< set on first use, see LoadRIRF()
+	mutable std::once_flag rirf_loaded;
 	hsize_t rirf_dims[3];
-	double* radiation_damping_matrix;
+	mutable const double* radiation_damping_matrix;        ///< set on first use, see LoadRadiationDamping()
+	mutable std::once_flag radiation_damping_loaded;
 	hsize_t radiation_damping_dims[3];
-	double* excitation_mag_matrix;
+	mutable const double* added_mass_matrix;               ///< A(w), set on first use, see LoadAddedMass()
+	mutable std::once_flag added_mass_loaded;
+	hsize_t added_mass_dims[3];
+	const double* excitation_mag_matrix;
 	hsize_t excitation_mag_dims[3];
-	double* excitation_phase_matrix;
+	const double* excitation_phase_matrix;
 	hsize_t excitation_phase_dims[3];
-	double* excitation_re_matrix;
+	const double* excitation_re_matrix;
 	hsize_t excitation_re_dims[3];
-	double* excitation_im_matrix;
+	const double* excitation_im_matrix;
 	hsize_t excitation_im_dims[3];
+	mutable std::vector<double> rirf_storage;
+	mutable std::vector<double> radiation_damping_storage;
+	mutable std::vector<double> added_mass_storage;
+	std::vector<double> excitation_mag_storage;
+	std::vector<double> excitation_phase_storage;
+	std::vector<double> excitation_re_storage;
+	std::vector<double> excitation_im_storage;
+	std::unique_ptr<MappedFile> baked_file;                ///< mapping the arrays point into when read from a baked file
 	ChVector<double> cg;
 	ChVector<double> cb;
 	std::vector<double> rirf_time_vector;
 	hsize_t freq_dims[3];
 	std::vector<double> freq_list;
+	std::vector<double> wave_headings;   ///< degrees, one per excitation column
 	double omega_min;
 	double omega_max;
 	double rho;
 	double g;
 	double disp_vol;
+	int body_number;
 	std::string h5_file_name;
 	std::string bodyNum;
 	void readH5Data();
+	void readBakedData();
+	void FindCouplingPatterns();
+	void LoadRIRF() const;
+	void LoadRadiationDamping() const;
+	void LoadAddedMass() const;
+};
+
+// =============================================================================
+enum class RadiationMode {
+	CONVOLUTION,  ///< direct convolution of the RIRF with the velocity history
+	STATE_SPACE   ///< RIRF approximated by a state space model fitted at load time
+};
+
+// =============================================================================
+enum class WaveMode {
+	NONE,      ///< still water, no excitation force
+	REGULAR,   ///< single regular wave
+	IRREGULAR  ///< JONSWAP / Pierson-Moskowitz sea as a sum of regular components
+};
+
+// =============================================================================
+enum class HydrostaticsMode {
+	LINEAR,    ///< hydrostatic stiffness matrix of the h5 file times the displacement from equilibrium
+	NONLINEAR  ///< still water pressure integrated over the instantaneous wetted surface of a mesh
 };
 
 // =============================================================================
@@ -93,74 +180,273 @@ public:
 		return regular_wave_omega;
 	}
 	double GetRegularWaveOmega() const { return regular_wave_omega; }
+	double SetWaveHeading(double val) {
+		wave_heading = val;
+		return wave_heading;
+	}
+	double GetWaveHeading() const { return wave_heading; }
+	double SetExcitationRampTime(double val) {
+		excitation_ramp_time = val;
+		return excitation_ramp_time;
+	}
+	double GetExcitationRampTime() const { return excitation_ramp_time; }
+	WaveMode SetWaveMode(WaveMode val) {
+		wave_mode = val;
+		return wave_mode;
+	}
+	WaveMode GetWaveMode() const { return wave_mode; }
+	double SetIrregularWaveHeight(double val) {
+		irregular_wave_height = val;
+		return irregular_wave_height;
+	}
+	double GetIrregularWaveHeight() const { return irregular_wave_height; }
+	double SetIrregularWavePeakPeriod(double val) {
+		irregular_wave_peak_period = val;
+		return irregular_wave_peak_period;
+	}
+	double GetIrregularWavePeakPeriod() const { return irregular_wave_peak_period; }
+	double SetIrregularWaveGamma(double val) {
+		irregular_wave_gamma = val;
+		return irregular_wave_gamma;
+	}
+	double GetIrregularWaveGamma() const { return irregular_wave_gamma; }
+	int SetIrregularWaveNumComponents(int val) {
+		irregular_wave_num_components = val;
+		return irregular_wave_num_components;
+	}
+	int GetIrregularWaveNumComponents() const { return irregular_wave_num_components; }
+	unsigned int SetIrregularWaveSeed(unsigned int val) {
+		irregular_wave_seed = val;
+		return irregular_wave_seed;
+	}
+	unsigned int GetIrregularWaveSeed() const { return irregular_wave_seed; }
+	double SetIrregularWaveOmegaMin(double val) {
+		irregular_wave_omega_min = val;
+		return irregular_wave_omega_min;
+	}
+	double GetIrregularWaveOmegaMin() const { return irregular_wave_omega_min; }
+	double SetIrregularWaveOmegaMax(double val) {
+		irregular_wave_omega_max = val;
+		return irregular_wave_omega_max;
+	}
+	double GetIrregularWaveOmegaMax() const { return irregular_wave_omega_max; }
+	bool SetIrregularWavePrecompute(bool val) {
+		irregular_wave_precompute = val;
+		return irregular_wave_precompute;
+	}
+	bool GetIrregularWavePrecompute() const { return irregular_wave_precompute; }
+	double SetIrregularWaveTimeStep(double val) {
+		irregular_wave_time_step = val;
+		return irregular_wave_time_step;
+	}
+	double GetIrregularWaveTimeStep() const { return irregular_wave_time_step; }
+	double SetIrregularWaveDuration(double val) {
+		irregular_wave_duration = val;
+		return irregular_wave_duration;
+	}
+	double GetIrregularWaveDuration() const { return irregular_wave_duration; }
+	std::string SetIrregularWaveSeriesFile(std::string val) {
+		irregular_wave_series_file = val;
+		return irregular_wave_series_file;
+	}
+	std::string GetIrregularWaveSeriesFile() const { return irregular_wave_series_file; }
+	RadiationMode SetRadiationMode(RadiationMode val) {
+		radiation_mode = val;
+		return radiation_mode;
+	}
+	RadiationMode GetRadiationMode() const { return radiation_mode; }
+	double SetRadiationTimeStep(double val) {
+		radiation_time_step = val;
+		return radiation_time_step;
+	}
+	double GetRadiationTimeStep() const { return radiation_time_step; }
+	double SetRIRFTruncationTolerance(double val) {
+		rirf_truncation_tolerance = val;
+		return rirf_truncation_tolerance;
+	}
+	double GetRIRFTruncationTolerance() const { return rirf_truncation_tolerance; }
+	int SetStateSpaceMaxOrder(int val) {
+		ss_max_order = val;
+		return ss_max_order;
+	}
+	int GetStateSpaceMaxOrder() const { return ss_max_order; }
+	double SetStateSpaceTolerance(double val) {
+		ss_tolerance = val;
+		return ss_tolerance;
+	}
+	double GetStateSpaceTolerance() const { return ss_tolerance; }
+	HydrostaticsMode SetHydrostaticsMode(HydrostaticsMode val) {
+		hydrostatics_mode = val;
+		return hydrostatics_mode;
+	}
+	HydrostaticsMode GetHydrostaticsMode() const { return hydrostatics_mode; }
+	std::vector<std::string> SetHydrostaticsMeshFiles(std::vector<std::string> val) {
+		hydrostatics_mesh_files = val;
+		return hydrostatics_mesh_files;
+	}
+	std::vector<std::string> GetHydrostaticsMeshFiles() const { return hydrostatics_mesh_files; }
 	
 private:
 	double regular_wave_amplitude;
 	double regular_wave_omega;
+	double wave_heading;                  ///< incident wave direction in degrees, as in the h5 file's wave_dir
+	double excitation_ramp_time;          ///< the excitation force ramps up from 0 over this many seconds, 0 switches it on at once
+	WaveMode wave_mode;
+	double irregular_wave_height;         ///< significant wave height Hs, m
+	double irregular_wave_peak_period;    ///< spectral peak period Tp, s
+	double irregular_wave_gamma;          ///< JONSWAP peak enhancement, 1 is Pierson-Moskowitz
+	int irregular_wave_num_components;
+	unsigned int irregular_wave_seed;     ///< seed of the random component phases
+	double irregular_wave_omega_min;      ///< 0 uses the h5 file's frequency range
+	double irregular_wave_omega_max;      ///< 0 uses the h5 file's frequency range
+	bool irregular_wave_precompute;       ///< synthesize the whole excitation time series up front
+	double irregular_wave_time_step;      ///< simulation time step, grid of the precomputed series
+	double irregular_wave_duration;       ///< shortest period of the precomputed series, s
+	std::string irregular_wave_series_file; ///< empty keeps the precomputed series in memory, must be unique per running system
+	RadiationMode radiation_mode;
+	double radiation_time_step;           ///< simulation time step the RIRF is resampled to for CONVOLUTION, 0 uses the h5 file's RIRF time step
+	double rirf_truncation_tolerance;     ///< fraction of each RIRF entry's energy its dropped tail may hold, 0 keeps every nonzero sample
+	int ss_max_order;     ///< max number of modes per RIRF entry in STATE_SPACE mode
+	double ss_tolerance;  ///< relative L2 fit error at which the order search stops
+	HydrostaticsMode hydrostatics_mode;
+	std::vector<std::string> hydrostatics_mesh_files;  ///< closed obj mesh per body (h5 file frame, at equilibrium) for NONLINEAR hydrostatics
 };
 
 // =============================================================================
-class HydroForces;
-class ForceTorqueFunc : public ChFunction {
-public:
-	ForceTorqueFunc(HydroForces* b, int i);
-	virtual ForceTorqueFunc* Clone() const override;
-	virtual double 	Get_y(double x) const override;
-	void SetBase(HydroForces* b);
-	void SetIndex(int i);
-private:
-	HydroForces* base;
-	int index;
+struct HydroBodyState {
+	double time;
+	ChVector<> pos;       ///< position of the body reference frame, absolute frame
+	ChQuaternion<> rot;   ///< rotation of the body reference frame
+	ChVector<> vel;       ///< linear velocity, absolute frame
+	ChVector<> wvel;      ///< angular velocity, absolute frame
+	bool operator==(const HydroBodyState& other) const {
+		return time == other.time && pos == other.pos && rot == other.rot && vel == other.vel && wvel == other.wvel;
+	}
+};
+
+// =============================================================================
+// HydroProfile
+// HydroForces call counters and time spent per force term. They are only
+// updated when the library is built with HYDROCHRONO_PROFILE defined (cmake
+// -DHYDROCHRONO_PROFILE=ON), otherwise the instrumentation compiles away and
+// every counter stays zero.
+// =============================================================================
+struct HydroProfile {
+	long long force_calls = 0;         ///< ComputeForce() calls
+	long long force_cache_hits = 0;    ///< ComputeForce() calls answered from the cached force vector
+	long long hydrostatics_calls = 0;
+	long long radiation_calls = 0;
+	long long history_advances = 0;    ///< new times pushed into the convolution velocity history
+	long long history_overwrites = 0;  ///< repeated times that replaced the newest history sample
+	long long excitation_calls = 0;
+	double hydrostatics_ns = 0;
+	double radiation_ns = 0;
+	double excitation_ns = 0;
+	size_t bytes_allocated = 0;        ///< heap held by the radiation, excitation and hydrostatics models
 };
 
 // =============================================================================
 class HydroForces {
 public:
 	HydroForces();
-	HydroForces(H5FileInfo& h5_file_info, std::shared_ptr<ChBody> object, HydroInputs users_hydro_inputs);
+	HydroForces(std::vector<std::shared_ptr<const H5FileInfo>> h5_file_infos, std::vector<std::shared_ptr<ChBody>> objects, HydroInputs users_hydro_inputs);
 	HydroForces(const HydroForces& other) = delete;
 	HydroForces operator = (const HydroForces& rhs) = delete;
-	ChVectorN<double, 6> ComputeForceHydrostatics();
-	ChVectorN<double, 6> ComputeForceRadiationDampingConv();
-	ChVectorN<double, 6> ComputeForceExcitationRegularFreq();
-	double coordinateFunc(int i);
-	void SetForce();
-	void SetTorque();
+	const ChVectorDynamic<double>& ComputeForce(const std::vector<HydroBodyState>& states);
+	ChVectorN<double, 6> ComputeForceHydrostatics(int b, const HydroBodyState& state);
+	const ChVectorDynamic<double>& ComputeForceRadiationDamping(const std::vector<HydroBodyState>& states);
+	const ChVectorDynamic<double>& ComputeForceRadiationDampingConv(const std::vector<HydroBodyState>& states);
+	const ChVectorDynamic<double>& ComputeForceRadiationDampingStateSpace(const std::vector<HydroBodyState>& states);
+	const ChVectorDynamic<double>& ComputeForceExcitation(const std::vector<HydroBodyState>& states);
+	ChVectorN<double, 6> ComputeForceExcitationRegularFreq(int b, const HydroBodyState& state);
+	const ChVectorDynamic<double>& ComputeForceExcitationIrregular(const std::vector<HydroBodyState>& states);
+	HydroBodyState GetBodyState(int b) const;
+	void SetBodyState(int b, const HydroBodyState& state);
+	bool WarmStart(const FrequencyDomainSolver& linear_model);
+	void SaveState(StateWriter& out) const;
+	bool RestoreState(StateReader& in, bool restore_bodies = true);
+	int GetNumBodies() const { return (int)bodies.size(); }
+	ChVectorN<double, 6> GetForce(int b) const { return force_total.segment<6>(6 * b); }
+	ChVectorN<double, 6> GetForceHydrostatics(int b) const { return force_hydrostatics.segment<6>(6 * b); }
+	ChVectorN<double, 6> GetForceRadiationDamping(int b) const { return force_radiation_damping.segment<6>(6 * b); }
+	ChVectorN<double, 6> GetForceExcitation(int b) const { return force_excitation.segment<6>(6 * b); }
+	std::shared_ptr<ChBody> GetBody(int b) const { return bodies[b]; }
+	HydroProfile GetProfile() const;
+	HydroProfile GetProfile(int b) const;
+	void ResetProfile();
+	void PrintProfile(std::ostream& out) const;
+	void PrintReport(std::ostream& out) const;
+	void PrintCouplingReport(std::ostream& out) const;
+	const std::string& GetSetupMessages() const { return setup_messages; }
+	static bool IsProfilingEnabled();
 private:
-	std::shared_ptr<ChBody> body;
-	H5FileInfo file_info;
+	HydroProfile profile;                                ///< all bodies together, hydrostatics in body_profile
+	std::vector<HydroProfile> body_profile;              ///< hydrostatics counters per body
+	std::vector<std::shared_ptr<ChBody>> bodies;
+	std::vector<std::shared_ptr<const H5FileInfo>> file_info;  ///< one per body, same order as bodies
 	HydroInputs hydro_inputs;
-	ChVectorN<double, 6> equilibrium;
-	ForceTorqueFunc forces[6];
-	std::shared_ptr<ForceTorqueFunc> force_ptrs[6];
-	ChVectorN<double, 6> force_hydrostatic;
-	ChVectorN<double, 6> force_radiation_damping;
-	ChVectorN<double, 6> force_excitation_freq;
+	ChVectorDynamic<double> equilibrium;                 ///< 6 per body
+	std::vector<NonlinearHydrostatics> nonlinear_hydrostatics;  ///< one per body in NONLINEAR mode, an empty mesh falls back to LINEAR
+	ChVectorDynamic<double> force_hydrostatics;          ///< 6 per body
+	ChVectorDynamic<double> force_radiation_damping;     ///< 6 per body
+	ChVectorDynamic<double> force_excitation;            ///< 6 per body
+	ChVectorDynamic<double> force_total;                 ///< 6 per body
+	std::vector<HydroBodyState> cached_states;           ///< states force_total was computed for
+	bool has_cached_state;
 	double wave_amplitude;
 	double wave_omega;
-	double wave_omega_delta;
-	double freq_index_des;
-	int freq_index_floor;
-	double freq_interp_val;
-	ChVectorN<double, 6> excitation_force_mag;
-	ChVectorN<double, 6> excitation_force_phase;
-	std::vector<ChVectorN<double, 6>> velocity_history;
-	double previous_time;
-	double previous_time_rirf;
-	double previous_time_ex;
-	std::vector<double> rirf_time_vector;
-	int offset;
-	std::shared_ptr<ChForce> chrono_force;
-	std::shared_ptr<ChForce> chrono_torque;
+	ChVectorDynamic<double> excitation_force_re;         ///< 6 per body, Re(A X(w, heading))
+	ChVectorDynamic<double> excitation_force_im;         ///< 6 per body, Im(A X(w, heading))
+	IrregularWaveExcitation irregular_excitation;
+	ExcitationTimeSeries excitation_time_series;
+	void ComputeExcitationCoefficients(const WaveComponents& components, std::vector<double>& coef_re, std::vector<double>& coef_im) const;
+	std::vector<int> rirf_col_offset;                    ///< first RIRF column of each body's DOFs
+	RadiationConvolution radiation_convolution;
+	RadiationStateSpace radiation_state_space;
+	std::vector<double> radiation_velocity;              ///< velocities of all 6N DOFs in the h5 file
+	double velocity_history_time;                        ///< time of the newest sample in the convolution history
+	std::string setup_messages;                          ///< constructor notes, see PrintReport()
+};
+
+// =============================================================================
+class ChLoadHydroForces : public ChLoadCustomMultiple {
+public:
+	ChLoadHydroForces(HydroForces* hydro_forces,   ///< evaluates the hydro force vector
+		std::vector<std::shared_ptr<ChBody>>& bodies  ///< objects to apply the hydro forces to, same order as in hydro_forces
+	);
+
+	/// "Virtual" copy constructor (covariant return type).
+	virtual ChLoadHydroForces* Clone() const override { return new ChLoadHydroForces(*this); }
+
+	/// Compute Q, the generalized load, from the hydro force vector evaluated once
+	/// for the given state (or the bodies' current state if state_x, state_w are null).
+	/// Called automatically at each Update().
+	virtual void ComputeQ(ChState* state_x,      ///< state position to evaluate Q
+		ChStateDelta* state_w  ///< state speed to evaluate Q
+	) override;
+private:
+	HydroForces* base;
+	std::vector<HydroBodyState> states;   ///< preallocated, one per body
 };
 
+// =============================================================================
+// ChLoadAddedMass
+// infinite frequency added mass of one or more bodies as a constant 6N x 6N
+// mass matrix load (body i's rows, body j's columns in block (i, j)), built
+// once at construction. The Jacobian M is filled on the first ComputeJacobian()
+// and left alone afterwards, and M*w only visits the nonzero entries.
+// The matrix is used as is for every body orientation, as in the h5 file's
+// linear model.
 // =============================================================================
 class ChLoadAddedMass : public ChLoadCustomMultiple {
 public:
+	ChLoadAddedMass(const std::vector<std::shared_ptr<const H5FileInfo>>& file_infos,   ///< one per body, in the same order as bodies
+		std::vector<std::shared_ptr<ChBody>>& bodies  ///< objects to apply additional inertia to
+		);
 	ChLoadAddedMass(const H5FileInfo& file,   ///< h5 file to initialize added mass with
 		std::vector<std::shared_ptr<ChBody>>& bodies  ///< objects to apply additional inertia to
 		);     
-	ChLoadAddedMass(const ChMatrixDynamic<>& addedMassMatrix,   ///< h5 file to initialize added mass with
+	ChLoadAddedMass(const ChMatrixDynamic<>& addedMassMatrix,   ///< 6N x 6N added mass, already scaled by rho
 		std::vector<std::shared_ptr<ChBody>>& bodies  ///< objects to apply additional inertia to
 	);
 
@@ -168,17 +454,14 @@ public:
 	virtual ChLoadAddedMass* Clone() const override { return new ChLoadAddedMass(*this); }
 
 	/// Compute Q, the generalized load.
-	/// In this case, it computes the quadratic (centrifugal, gyroscopic) terms.
-	/// Signs are negative as Q assumed at right hand side, so Q= -Fgyro -Fcentrifugal
-	/// Called automatically at each Update().
-	/// The M*a term is not added: to this end one could use LoadIntLoadResidual_Mv afterward.
+	/// The added mass has no velocity dependent terms, so Q is zero.
+	/// The M*a term is not added here, it comes from the Jacobian M and LoadIntLoadResidual_Mv.
 	virtual void ComputeQ(ChState* state_x,      ///< state position to evaluate Q
 		ChStateDelta* state_w  ///< state speed to evaluate Q
 	) override {}
 
-	/// For efficiency reasons, do not let the parent class do automatic differentiation
-	/// to compute the R, K matrices. Use analytic expressions instead. For example, R is
-	/// the well known gyroscopic damping matrix. Also, compute the M matrix.
+	/// M is the constant added mass matrix, R and K are zero. They are written
+	/// once per Jacobian storage, later calls (every Update()) return at once.
 	virtual void ComputeJacobian(ChState* state_x,       ///< state position to evaluate jacobians
 		ChStateDelta* state_w,  ///< state speed to evaluate jacobians
 		ChMatrixRef mK,         ///< result -dQ/dx
@@ -186,12 +469,18 @@ public:
 		ChMatrixRef mM          ///< result -dQ/da
 	) override;
 
-	/// Just for efficiency, override the default LoadIntLoadResidual_Mv, because we can do this in a simplified way.
+	/// R += c*M*w over the nonzero entries of M, at each body's offset in R and w.
 	virtual void LoadIntLoadResidual_Mv(ChVectorDynamic<>& R,           ///< result: the R residual, R += c*M*w
 		const ChVectorDynamic<>& w,     ///< the w vector
 		const double c) override;       ///< a scaling factor
+
+	const ChMatrixDynamic<double>& GetAddedMassMatrix() const { return inf_added_mass_J; }
+	const CouplingPattern& GetAddedMassPattern() const { return added_mass_pattern; }
+	static ChMatrixDynamic<double> BuildAddedMassMatrix(const std::vector<std::shared_ptr<const H5FileInfo>>& file_infos);
 private:
-	ChMatrixDynamic<double> inf_added_mass_J;       ///< added mass at infinite frequency in global coordinates
+	ChMatrixDynamic<double> inf_added_mass_J;       ///< 6N x 6N added mass at infinite frequency, scaled by rho
+	CouplingPattern added_mass_pattern;             ///< nonzero entries of inf_added_mass_J
+	const ChLoadJacobians* jacobian_filled;         ///< Jacobian storage M was last written to
 
 	virtual bool IsStiff() override { return true; } // this to force the use of the inertial M, R and K matrices
 
@@ -200,10 +489,18 @@ private:
 class LoadAllHydroForces {
 public:
 	LoadAllHydroForces(std::shared_ptr<ChBody> object, std::string file, std::string body_name, HydroInputs users_hydro_inputs);
+	LoadAllHydroForces(std::vector<std::shared_ptr<ChBody>> objects, std::string file, HydroInputs users_hydro_inputs);
+	ChVectorN<double, 6> GetForce(int b = 0) const { return hydro_force.GetForce(b); }
+	const HydroForces& GetHydroForces() const { return hydro_force; }
+	HydroForces& GetHydroForces() { return hydro_force; }
 private:
-	H5FileInfo sys_file_info;
+	LoadAllHydroForces(std::vector<std::shared_ptr<ChBody>> objects, std::vector<std::string> body_names, std::string file, HydroInputs users_hydro_inputs);
+	static std::vector<std::string> DefaultBodyNames(size_t num_bodies);
+	static std::vector<std::shared_ptr<const H5FileInfo>> ReadFileInfos(std::string file, const std::vector<std::string>& body_names);
+	std::vector<std::shared_ptr<const H5FileInfo>> sys_file_info;
 	HydroForces hydro_force;
 	HydroInputs users_hydro_inputs;
-	//std::shared_ptr<ChLoadContainer> my_loadcontainer;
-	//std::shared_ptr<ChLoadAddedMass> my_loadbodyinertia;
+	std::shared_ptr<ChLoadContainer> my_loadcontainer;
+	std::shared_ptr<ChLoadHydroForces> my_hydro_load;
+	std::shared_ptr<ChLoadAddedMass> my_added_mass_load;
 };
@@ -0,0 +1,570 @@
+#include "hydro_forces.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+
+// micro and macro benchmarks of the hydro force stack, usage:
+//   hydrochrono_bench [--filter text] [--min-time seconds] [--data dir] [--csv file]
+// every benchmark whose name contains text is run until at least min-time
+// seconds have been timed, and reports time and heap allocations per iteration.
+// Benchmarks of the per step force path must not allocate at all, if one does
+// it is reported and the run exits with 1.
+// Macro benchmarks step a whole headless demo model, one iteration is one step.
+// dir holds sphere.h5, rm3.h5 and meshFiles/ (default ../../HydroChrono/),
+// file gets one csv line per benchmark for comparing releases
+
+// =============================================================================
+// heap allocation counting. With glibc malloc itself is replaced, so every
+// allocation in the process is counted, operator new, Eigen's aligned_malloc
+// and the C libraries' alike. Elsewhere only the operator new family is
+// =============================================================================
+namespace {
+	std::atomic<long long> num_allocations(0);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t num, size_t size);
+	void* __libc_realloc(void* p, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+
+	void* malloc(size_t size) noexcept {
+		num_allocations++;
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t num, size_t size) noexcept {
+		num_allocations++;
+		return __libc_calloc(num, size);
+	}
+
+	void* realloc(void* p, size_t size) noexcept {
+		num_allocations++;
+		return __libc_realloc(p, size);
+	}
+
+	void* memalign(size_t alignment, size_t size) noexcept {
+		num_allocations++;
+		return __libc_memalign(alignment, size);
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept {
+		num_allocations++;
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void** p, size_t alignment, size_t size) noexcept {
+		if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+			return EINVAL;
+		}
+		num_allocations++;
+		*p = __libc_memalign(alignment, size);
+		return *p != nullptr || size == 0 ? 0 : ENOMEM;
+	}
+}
+#else
+void* operator new(size_t size) {
+	num_allocations++;
+	if (void* p = std::malloc(size > 0 ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+// over aligned types get a block from malloc with the pointer malloc returned stored just before it
+void* operator new(size_t size, std::align_val_t alignment) {
+	num_allocations++;
+	size_t align = std::max((size_t)alignment, sizeof(void*));
+	void* base = std::malloc(size + align);
+	if (base == nullptr) {
+		throw std::bad_alloc();
+	}
+	void* p = (void*)(((uintptr_t)base + align) & ~(uintptr_t)(align - 1));
+	((void**)p)[-1] = base;
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	if (p != nullptr) {
+		std::free(((void**)p)[-1]);
+	}
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept {
+	operator delete(p, alignment);
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+	operator delete(p, alignment);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept {
+	operator delete(p, alignment);
+}
+#endif
+
+// =============================================================================
+// benchmark runner
+// =============================================================================
+namespace {
+	struct BenchSettings {
+		std::string filter;
+		double min_time = 0.5;
+		std::string data_dir = "../../HydroChrono/";
+		std::ofstream csv;
+		bool failed = false;  ///< a heap free benchmark allocated
+	};
+
+	const bool kHeapFree = true;  ///< RunBenchmark() argument for the per step force path
+
+	/*******************************************************************************
+	* IsSelected()
+	* true if the filter picks benchmark name
+	*******************************************************************************/
+	bool IsSelected(const BenchSettings& settings, const std::string& name) {
+		return name.find(settings.filter) != std::string::npos;
+	}
+
+	/*******************************************************************************
+	* RunBenchmark()
+	* calls body 1, 2, 4, ... times until one batch takes at least min_time, and
+	* prints that batch's time per call and the allocations per call over all
+	* batches. With heap_free any allocation after the warm up call fails the
+	* run. Skipped (returns false) unless name contains the filter
+	*******************************************************************************/
+	bool RunBenchmark(BenchSettings& settings, const std::string& name, const std::function<void()>& body, bool heap_free = false) {
+		if (!IsSelected(settings, name)) {
+			return false;
+		}
+		body(); // warm up caches and lazily loaded data
+		long long iterations = 1;
+		double elapsed = 0;
+		long long allocations_before = num_allocations;
+		long long total_iterations = 0;
+		while (true) {
+			auto start = std::chrono::high_resolution_clock::now();
+			for (long long i = 0; i < iterations; i++) {
+				body();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			elapsed = std::chrono::duration<double>(end - start).count();
+			total_iterations += iterations;
+			if (elapsed >= settings.min_time || iterations >= (1LL << 40)) {
+				break;
+			}
+			iterations *= 2;
+		}
+		long long allocations = num_allocations - allocations_before;
+		double ns_per_iteration = 1e9 * elapsed / iterations;
+		double allocations_per_iteration = (double)allocations / total_iterations;
+		printf("%-48s %14.1f ns %12lld iterations %10.2f allocs/iter %14.1f iter/s\n", name.c_str(), ns_per_iteration, iterations,
+			allocations_per_iteration, iterations / elapsed);
+		if (settings.csv.is_open()) {
+			settings.csv << name << "," << ns_per_iteration << "," << iterations << "," << allocations_per_iteration << "\n";
+		}
+		if (heap_free && allocations > 0) {
+			printf("%-48s FAILED, %lld heap allocations on a path that must not allocate\n", name.c_str(), allocations);
+			settings.failed = true;
+		}
+		return true;
+	}
+
+	/*******************************************************************************
+	* RandomVector()
+	* size normally distributed values, the same for the same seed
+	*******************************************************************************/
+	std::vector<double> RandomVector(size_t size, unsigned int seed) {
+		std::mt19937 generator(seed);
+		std::normal_distribution<double> distribution;
+		std::vector<double> values(size);
+		for (double& val : values) {
+			val = distribution(generator);
+		}
+		return values;
+	}
+
+	/*******************************************************************************
+	* MakeSphere()
+	* the sphere of the sphere demos, added to system
+	*******************************************************************************/
+	std::shared_ptr<ChBody> MakeSphere(ChSystem& system) {
+		std::shared_ptr<ChBody> body = chrono_types::make_shared<ChBodyEasySphere>(5, 1);
+		system.Add(body);
+		body->SetPos(ChVector<>(0, 0, -2));
+		body->SetMass(261.8e3);
+		return body;
+	}
+
+	/*******************************************************************************
+	* UseDemoSolver()
+	* GMRES as in the demos
+	*******************************************************************************/
+	void UseDemoSolver(ChSystem& system) {
+		auto gmres_solver = chrono_types::make_shared<ChSolverGMRES>();
+		gmres_solver->SetMaxIterations(300);
+		system.SetSolver(gmres_solver);
+	}
+}
+
+// =============================================================================
+// micro benchmarks
+// =============================================================================
+
+/*******************************************************************************
+* BenchHydrostatics()
+* ComputeForceHydrostatics() of the sphere
+*******************************************************************************/
+void BenchHydrostatics(BenchSettings& settings) {
+	if (!IsSelected(settings, "Hydrostatics/sphere")) {
+		return;
+	}
+	std::string sphere_file = settings.data_dir + "sphere.h5";
+	auto body = chrono_types::make_shared<ChBody>();
+	body->SetPos(ChVector<>(0, 0, -2.1));
+	HydroForces hydro_forces({ H5FileInfo::Load(sphere_file, "body1") }, { body }, HydroInputs());
+	HydroBodyState state = hydro_forces.GetBodyState(0);
+	ChVectorN<double, 6> force;
+	RunBenchmark(settings, "Hydrostatics/sphere", [&]() {
+		force = hydro_forces.ComputeForceHydrostatics(0, state);
+	}, kHeapFree);
+}
+
+/*******************************************************************************
+* BenchNonlinearHydrostatics()
+* ComputeForceHydrostatics() of the sphere from its mesh, the body heaves and
+* rolls a little every call so panels keep crossing the waterline
+*******************************************************************************/
+void BenchNonlinearHydrostatics(BenchSettings& settings) {
+	if (!IsSelected(settings, "Hydrostatics/sphere_nonlinear")) {
+		return;
+	}
+	std::string sphere_file = settings.data_dir + "sphere.h5";
+	auto body = chrono_types::make_shared<ChBody>();
+	body->SetPos(ChVector<>(0, 0, -2.1));
+	HydroInputs hydro_inputs;
+	hydro_inputs.SetHydrostaticsMode(HydrostaticsMode::NONLINEAR);
+	hydro_inputs.SetHydrostaticsMeshFiles({ settings.data_dir + "meshFiles/oes_task10_sphere.obj" });
+	HydroForces hydro_forces({ H5FileInfo::Load(sphere_file, "body1") }, { body }, hydro_inputs);
+	HydroBodyState state = hydro_forces.GetBodyState(0);
+	ChVectorN<double, 6> force;
+	int call = 0;
+	RunBenchmark(settings, "Hydrostatics/sphere_nonlinear", [&]() {
+		double phase = 0.01 * (call++ % 628);
+		state.pos = ChVector<>(0, 0, -2 + 0.5 * sin(phase));
+		state.rot = Q_from_AngX(0.1 * cos(phase));
+		force = hydro_forces.ComputeForceHydrostatics(0, state);
+	}, kHeapFree);
+}
+
+/*******************************************************************************
+* BenchRadiationConvolution()
+* one step of the radiation convolution (advance, set velocities, compute) for
+* synthetic square kernels of several RIRF lengths and DOF counts
+*******************************************************************************/
+void BenchRadiationConvolution(BenchSettings& settings) {
+	for (int num_cols : { 6, 12, 60 }) {
+		for (int num_steps : { 250, 1000, 4000 }) {
+			std::string name = "RadiationConv/steps:" + std::to_string(num_steps) + "/cols:" + std::to_string(num_cols);
+			if (!IsSelected(settings, name)) {
+				continue;
+			}
+			std::vector<double> rirf = RandomVector((size_t)num_cols * num_cols * num_steps, 1);
+			std::vector<double> rirf_time_vector(num_steps);
+			for (int st = 0; st < num_steps; st++) {
+				rirf_time_vector[st] = 0.01 * st;
+			}
+			RadiationConvolution convolution(num_cols, num_cols, rirf, rirf_time_vector);
+			std::vector<double> velocity = RandomVector(num_cols, 2);
+			std::vector<double> force(num_cols);
+			RunBenchmark(settings, name, [&]() {
+				convolution.Advance();
+				for (int col = 0; col < num_cols; col++) {
+					convolution.SetVelocity(col, velocity[col]);
+				}
+				convolution.Compute(force.data());
+			}, kHeapFree);
+		}
+	}
+}
+
+/*******************************************************************************
+* BenchExcitation()
+* regular wave excitation of the sphere, irregular excitation summed per step
+* and read from a precomputed time series, each at a new time every call
+*******************************************************************************/
+void BenchExcitation(BenchSettings& settings) {
+	if (IsSelected(settings, "Excitation/regular/sphere")) {
+		std::string sphere_file = settings.data_dir + "sphere.h5";
+		auto body = chrono_types::make_shared<ChBody>();
+		HydroInputs regular_inputs;
+		regular_inputs.SetRegularWaveAmplitude(0.095);
+		regular_inputs.SetRegularWaveOmega(1.427996661);
+		HydroForces hydro_forces({ H5FileInfo::Load(sphere_file, "body1") }, { body }, regular_inputs);
+		std::vector<HydroBodyState> states = { hydro_forces.GetBodyState(0) };
+		RunBenchmark(settings, "Excitation/regular/sphere", [&]() {
+			states[0].time += 0.015;
+			hydro_forces.ComputeForceExcitation(states);
+		}, kHeapFree);
+	}
+
+	const int num_dofs = 6;
+	double force[num_dofs];
+	for (int num_components : { 100, 1000 }) {
+		std::string name = "Excitation/irregular/components:" + std::to_string(num_components);
+		if (!IsSelected(settings, name)) {
+			continue;
+		}
+		std::vector<double> omegas(num_components);
+		for (int k = 0; k < num_components; k++) {
+			omegas[k] = 0.2 + 3.0 * k / num_components;
+		}
+		IrregularWaveExcitation excitation(num_dofs, omegas, RandomVector((size_t)num_dofs * num_components, 3), RandomVector((size_t)num_dofs * num_components, 4));
+		double time = 0;
+		RunBenchmark(settings, name, [&]() {
+			time += 0.015;
+			excitation.Compute(time, force);
+		}, kHeapFree);
+	}
+
+	if (!IsSelected(settings, "Excitation/time_series/components:1000")) {
+		return;
+	}
+	int num_samples = 1 << 16;
+	std::vector<int> bins(1000);
+	for (size_t k = 0; k < bins.size(); k++) {
+		bins[k] = (int)k + 1;
+	}
+	ExcitationTimeSeries series(num_dofs, 0.015, num_samples, bins, RandomVector(num_dofs * bins.size(), 5), RandomVector(num_dofs * bins.size(), 6));
+	double time = 0;
+	RunBenchmark(settings, "Excitation/time_series/components:1000", [&]() {
+		time += 0.015;
+		series.Compute(time, force);
+	}, kHeapFree);
+}
+
+/*******************************************************************************
+* BenchForceStep()
+* one step of the sphere's complete hydro force (HydroForces::ComputeForce())
+* in regular and irregular waves, evaluated twice per step like the
+* integrator does, with the body heaving so nothing is answered from a cache
+*******************************************************************************/
+void BenchForceStep(BenchSettings& settings) {
+	std::string sphere_file = settings.data_dir + "sphere.h5";
+	for (WaveMode wave_mode : { WaveMode::REGULAR, WaveMode::IRREGULAR }) {
+		std::string name = std::string("ForceStep/") + (wave_mode == WaveMode::REGULAR ? "regular" : "irregular") + "/sphere";
+		if (!IsSelected(settings, name)) {
+			continue;
+		}
+		auto body = chrono_types::make_shared<ChBody>();
+		body->SetPos(ChVector<>(0, 0, -2));
+		HydroInputs hydro_inputs;
+		hydro_inputs.SetRegularWaveAmplitude(0.095);
+		hydro_inputs.SetRegularWaveOmega(1.427996661);
+		hydro_inputs.SetIrregularWaveHeight(1.0);
+		hydro_inputs.SetIrregularWavePeakPeriod(8.0);
+		hydro_inputs.SetWaveMode(wave_mode);
+		HydroForces hydro_forces({ H5FileInfo::Load(sphere_file, "body1") }, { body }, hydro_inputs);
+		std::vector<HydroBodyState> states = { hydro_forces.GetBodyState(0) };
+		int call = 0;
+		RunBenchmark(settings, name, [&]() {
+			double phase = 0.01 * (call++ % 628);
+			states[0].time += 0.015;
+			states[0].pos = ChVector<>(0, 0, -2 + 0.5 * sin(phase));
+			states[0].vel = ChVector<>(0, 0, 0.5 * cos(phase));
+			hydro_forces.ComputeForce(states);
+			states[0].vel = ChVector<>(0, 0, 0.5 * cos(phase + 0.005));
+			hydro_forces.ComputeForce(states);
+		}, kHeapFree);
+	}
+}
+
+/*******************************************************************************
+* BenchH5FileInfo()
+* reading the sphere's hydro data without the cache, from the h5 file (with and
+* without the lazily read RIRF) and from a baked copy
+*******************************************************************************/
+void BenchH5FileInfo(BenchSettings& settings) {
+	std::string sphere_file = settings.data_dir + "sphere.h5";
+	RunBenchmark(settings, "H5FileInfo/h5/sphere", [&]() {
+		H5FileInfo info(sphere_file, "body1");
+	});
+	RunBenchmark(settings, "H5FileInfo/h5_with_rirf/sphere", [&]() {
+		H5FileInfo info(sphere_file, "body1");
+		info.GetRIRFval(0, 0, 0);
+	});
+	if (IsSelected(settings, "H5FileInfo/baked/sphere")) {
+		std::string baked_file = "hydrochrono_bench_sphere.hcb";
+		try {
+			H5FileInfo::Bake(sphere_file, baked_file);
+		}
+		catch (const std::exception& e) {
+			std::cout << "H5FileInfo/baked/sphere skipped, " << e.what() << "\n";
+			std::remove(baked_file.c_str());
+			return;
+		}
+		RunBenchmark(settings, "H5FileInfo/baked/sphere", [&]() {
+			H5FileInfo info(baked_file, "body1");
+			info.GetRIRFval(0, 0, 0);
+		});
+		std::remove(baked_file.c_str());
+	}
+}
+
+// =============================================================================
+// macro benchmarks, headless versions of the demos
+// =============================================================================
+
+/*******************************************************************************
+* BenchSphereDecay()
+* sphere_decay_no_viz, free heave decay from 2 m below equilibrium
+*******************************************************************************/
+void BenchSphereDecay(BenchSettings& settings) {
+	if (!IsSelected(settings, "Macro/sphere_decay")) {
+		return;
+	}
+	ChSystemNSC system;
+	system.Set_G_acc(ChVector<>(0, 0, -9.81));
+	std::shared_ptr<ChBody> body = MakeSphere(system);
+	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetWaveMode(WaveMode::NONE);
+	LoadAllHydroForces blah(body, settings.data_dir + "sphere.h5", "body1", my_hydro_inputs);
+	UseDemoSolver(system);
+	RunBenchmark(settings, "Macro/sphere_decay", [&]() {
+		system.DoStepDynamics(0.015);
+	});
+}
+
+/*******************************************************************************
+* BenchSphereRegularWaves()
+* sphere_reg_waves_no_viz wave case 3, with the PTO damper to ground
+*******************************************************************************/
+void BenchSphereRegularWaves(BenchSettings& settings) {
+	if (!IsSelected(settings, "Macro/sphere_reg_waves")) {
+		return;
+	}
+	ChSystemNSC system;
+	system.Set_G_acc(ChVector<>(0, 0, -9.81));
+	auto ground = chrono_types::make_shared<ChBody>();
+	system.AddBody(ground);
+	ground->SetPos(ChVector<>(0, 0, -5));
+	ground->SetBodyFixed(true);
+	ground->SetCollide(false);
+	std::shared_ptr<ChBody> body = MakeSphere(system);
+	auto spring_1 = chrono_types::make_shared<ChLinkTSDA>();
+	spring_1->Initialize(body, ground, true, ChVector<>(0, 0, -2), ChVector<>(0, 0, -5));
+	spring_1->SetRestLength(3.0);
+	spring_1->SetSpringCoefficient(0.0);
+	spring_1->SetDampingCoefficient(90080.857);
+	system.AddLink(spring_1);
+	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRegularWaveAmplitude(0.095);
+	my_hydro_inputs.SetRegularWaveOmega(1.427996661);
+	LoadAllHydroForces blah(body, settings.data_dir + "sphere.h5", "body1", my_hydro_inputs);
+	UseDemoSolver(system);
+	RunBenchmark(settings, "Macro/sphere_reg_waves", [&]() {
+		system.DoStepDynamics(0.015);
+	});
+}
+
+/*******************************************************************************
+* BenchRM3()
+* rm3_demo without visualization, float and plate with coupled radiation
+*******************************************************************************/
+void BenchRM3(BenchSettings& settings) {
+	if (!IsSelected(settings, "Macro/rm3")) {
+		return;
+	}
+	std::string rm3_file = settings.data_dir + "rm3.h5";
+	if (!std::ifstream(rm3_file).good()) {
+		std::cout << "Macro/rm3 skipped, " << rm3_file << " not found\n";
+		return;
+	}
+	ChSystemNSC system;
+	system.Set_G_acc(ChVector<>(0, 0, -9.81));
+	std::vector<std::shared_ptr<ChBody>> bodies;
+	for (std::string mesh : { "float.obj", "plate.obj" }) {
+		std::shared_ptr<ChBody> body = chrono_types::make_shared<ChBodyEasyMesh>(settings.data_dir + "meshFiles/" + mesh, 1000, false, false, false, nullptr, 0);
+		system.Add(body);
+		body->SetMass(886.691 * 1000);
+		body->SetCollide(false);
+		bodies.push_back(body);
+	}
+	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRegularWaveAmplitude(0.022);
+	my_hydro_inputs.SetRegularWaveOmega(2.10);
+	LoadAllHydroForces hydroForces(bodies, rm3_file, my_hydro_inputs);
+	UseDemoSolver(system);
+	RunBenchmark(settings, "Macro/rm3", [&]() {
+		system.DoStepDynamics(0.06);
+	});
+}
+
+int main(int argc, char* argv[]) {
+	BenchSettings settings;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		if (option == "--filter") {
+			settings.filter = argv[i + 1];
+		}
+		else if (option == "--min-time") {
+			settings.min_time = atof(argv[i + 1]);
+		}
+		else if (option == "--data") {
+			settings.data_dir = argv[i + 1];
+			if (!settings.data_dir.empty() && settings.data_dir.back() != '/' && settings.data_dir.back() != '\\') {
+				settings.data_dir += "/";
+			}
+		}
+		else if (option == "--csv") {
+			settings.csv.open(argv[i + 1], std::ofstream::out);
+			settings.csv << "benchmark,ns_per_iteration,iterations,allocations_per_iteration\n";
+		}
+		else {
+			std::cout << "unknown option " << option << "\n";
+			return 1;
+		}
+	}
+	std::cout << "dot product kernel: " << RadiationConvolution::GetKernelName() << "\n";
+
+	BenchHydrostatics(settings);
+	BenchNonlinearHydrostatics(settings);
+	BenchRadiationConvolution(settings);
+	BenchExcitation(settings);
+	BenchForceStep(settings);
+	BenchH5FileInfo(settings);
+	BenchSphereDecay(settings);
+	BenchSphereRegularWaves(settings);
+	BenchRM3(settings);
+	return settings.failed ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =============================================================================
+// MappedFile Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* MappedFile default constructor
+* no file open, Map() returns nullptr
+*******************************************************************************/
+MappedFile::MappedFile() : file_size(0), is_writable(false), view(nullptr), view_length(0) {
+#ifdef _WIN32
+	file_handle = INVALID_HANDLE_VALUE;
+	mapping_handle = nullptr;
+#else
+	file_descriptor = -1;
+#endif
+}
+
+/*******************************************************************************
+* MappedFile destructor
+* unmaps the view and closes the file
+*******************************************************************************/
+MappedFile::~MappedFile() {
+	Close();
+}
+
+/*******************************************************************************
+* MappedFile::GetGranularity()
+* file offsets of mapped views must be multiples of this (page size on POSIX,
+* allocation granularity on Windows)
+*******************************************************************************/
+size_t MappedFile::GetGranularity() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/*******************************************************************************
+* MappedFile::IsOpen()
+*******************************************************************************/
+bool MappedFile::IsOpen() const {
+#ifdef _WIN32
+	return file_handle != INVALID_HANDLE_VALUE;
+#else
+	return file_descriptor >= 0;
+#endif
+}
+
+/*******************************************************************************
+* MappedFile::Open()
+* opens an existing file, nothing is mapped until Map() is called
+* returns false if the file can't be opened
+*******************************************************************************/
+bool MappedFile::Open(const std::string& path, bool writable) {
+	Close();
+	is_writable = writable;
+#ifdef _WIN32
+	file_handle = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file_handle, &size);
+	file_size = (size_t)size.QuadPart;
+	mapping_handle = file_size > 0 ? CreateFileMappingA(file_handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	if (file_size > 0 && mapping_handle == nullptr) {
+		Close();
+		return false;
+	}
+#else
+	file_descriptor = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+	if (file_descriptor < 0) {
+		return false;
+	}
+	struct stat info;
+	fstat(file_descriptor, &info);
+	file_size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+/*******************************************************************************
+* MappedFile::Create()
+* creates (or truncates) the file at path with size bytes and opens it for
+* reading and writing
+* returns false if the file can't be created
+*******************************************************************************/
+bool MappedFile::Create(const std::string& path, size_t size) {
+	Close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER end;
+	end.QuadPart = (LONGLONG)size;
+	bool resized = SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) && SetEndOfFile(handle);
+	CloseHandle(handle);
+	if (!resized) {
+		return false;
+	}
+#else
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	bool resized = ftruncate(fd, (off_t)size) == 0;
+	close(fd);
+	if (!resized) {
+		return false;
+	}
+#endif
+	return Open(path, true);
+}
+
+/*******************************************************************************
+* MappedFile::Map()
+* maps bytes [offset, offset + length) of the file, replacing the previous view
+* returns a pointer to the byte at offset, or nullptr if the range is outside
+* the file or can't be mapped
+*******************************************************************************/
+char* MappedFile::Map(size_t offset, size_t length) {
+	Unmap();
+	if (!IsOpen() || length == 0 || offset + length > file_size) {
+		return nullptr;
+	}
+	size_t aligned_offset = offset - offset % GetGranularity();
+	size_t delta = offset - aligned_offset;
+#ifdef _WIN32
+	view = MapViewOfFile(mapping_handle, is_writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+		(DWORD)((unsigned long long)aligned_offset >> 32), (DWORD)(aligned_offset & 0xffffffffu), length + delta);
+	if (view == nullptr) {
+		return nullptr;
+	}
+#else
+	view = mmap(nullptr, length + delta, is_writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file_descriptor, (off_t)aligned_offset);
+	if (view == MAP_FAILED) {
+		view = nullptr;
+		return nullptr;
+	}
+#endif
+	view_length = length + delta;
+	return (char*)view + delta;
+}
+
+/*******************************************************************************
+* MappedFile::Unmap()
+* releases the current view, pointers returned by Map() become invalid
+*******************************************************************************/
+void MappedFile::Unmap() {
+	if (view == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+#else
+	munmap(view, view_length);
+#endif
+	view = nullptr;
+	view_length = 0;
+}
+
+/*******************************************************************************
+* MappedFile::Close()
+* unmaps the view and closes the file, modified pages are written back
+*******************************************************************************/
+void MappedFile::Close() {
+	Unmap();
+#ifdef _WIN32
+	if (mapping_handle != nullptr) {
+		CloseHandle(mapping_handle);
+		mapping_handle = nullptr;
+	}
+	if (file_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_handle);
+		file_handle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (file_descriptor >= 0) {
+		close(file_descriptor);
+		file_descriptor = -1;
+	}
+#endif
+	file_size = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// =============================================================================
+// MappedFile
+// read only or read/write memory mapping of a file, one window at a time, so
+// files larger than the address space (or than is worth keeping resident) can
+// be streamed through a fixed size view. Windows and POSIX implementations.
+// =============================================================================
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator = (const MappedFile& rhs) = delete;
+	bool Open(const std::string& path, bool writable = false);
+	bool Create(const std::string& path, size_t size);
+	char* Map(size_t offset, size_t length);
+	void Unmap();
+	void Close();
+	bool IsOpen() const;
+	size_t GetSize() const { return file_size; }
+	static size_t GetGranularity();
+private:
+	size_t file_size;
+	bool is_writable;
+	void* view;          ///< start of the mapped view, aligned to GetGranularity()
+	size_t view_length;  ///< bytes mapped at view
+#ifdef _WIN32
+	void* file_handle;
+	void* mapping_handle;
+#else
+	int file_descriptor;
+#endif
+};
@@ -0,0 +1,526 @@
+#include "nonlinear_hydrostatics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "simd_kernels.h"
+
+namespace {
+	/*******************************************************************************
+	* Cross()
+	* out = a x b
+	*******************************************************************************/
+	inline void Cross(const double* a, const double* b, double* out) {
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	/*******************************************************************************
+	* AddTriangle()
+	* adds the integrals of z n and z d x n over one wet triangle to force and
+	* torque, d being the corners relative to the reference point (absolute
+	* frame) and z their heights. z is linear over the triangle, so
+	*   integral z dA   = A (z0 + z1 + z2) / 3
+	*   integral z d dA = A (sum z_k d_k + 9 z_c d_c) / 12
+	*******************************************************************************/
+	void AddTriangle(const double* d0, const double* d1, const double* d2, double z0, double z1, double z2, double* force, double* torque) {
+		double e1[3] = { d1[0] - d0[0], d1[1] - d0[1], d1[2] - d0[2] };
+		double e2[3] = { d2[0] - d0[0], d2[1] - d0[1], d2[2] - d0[2] };
+		double area[3];
+		Cross(e1, e2, area);
+		double zc = (z0 + z1 + z2) / 3;
+		double q[3];
+		for (int i = 0; i < 3; i++) {
+			area[i] *= 0.5;
+			force[i] += zc * area[i];
+			q[i] = (z0 * d0[i] + z1 * d1[i] + z2 * d2[i] + 3 * zc * (d0[i] + d1[i] + d2[i])) / 12;
+		}
+		double t[3];
+		Cross(q, area, t);
+		for (int i = 0; i < 3; i++) {
+			torque[i] += t[i];
+		}
+	}
+}
+
+// =============================================================================
+// NonlinearHydrostatics Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* NonlinearHydrostatics default constructor
+* empty mesh, Compute() returns zero
+*******************************************************************************/
+NonlinearHydrostatics::NonlinearHydrostatics()
+	: rho_g(0), volume(0), num_open_edges(0), num_clipped(0), num_updates(0) {
+	std::fill(wet_sums, wet_sums + kNumIntegrals, 0.0);
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics constructor
+* vertices: x y z of each vertex in the frame the body reference point is at
+* origin at equilibrium (the h5 file's frame), triangles: 3 vertex indices per
+* panel. The winding is flipped if the normals point inwards. Per panel with
+* area vector a (outward normal times area), centroid c and corners r_k, all
+* relative to origin, the constructor stores
+*   a, S = a c^T, m = c x a, T = -[a]x (sum r_k r_k^T + 9 c c^T) / 12
+* so that for a panel fully below z = 0 (body frame integrals, z = pos_z + R2 r)
+*   integral z n dA     = pos_z a + S R2^T
+*   integral z r x n dA = pos_z m + T R2^T
+* with R2 the third row of the body rotation
+*******************************************************************************/
+NonlinearHydrostatics::NonlinearHydrostatics(const std::vector<double>& vertices, const std::vector<int>& triangles, const double origin[3], double rho_g_val)
+	: NonlinearHydrostatics() {
+	rho_g = rho_g_val;
+	int num_vertices = (int)vertices.size() / 3;
+	int num_panels = (int)triangles.size() / 3;
+	vertex_x.resize(num_vertices);
+	vertex_y.resize(num_vertices);
+	vertex_z.resize(num_vertices);
+	for (int v = 0; v < num_vertices; v++) {
+		vertex_x[v] = vertices[3 * v] - origin[0];
+		vertex_y[v] = vertices[3 * v + 1] - origin[1];
+		vertex_z[v] = vertices[3 * v + 2] - origin[2];
+	}
+	auto corner_pos = [this](int v, double* r) {
+		r[0] = vertex_x[v];
+		r[1] = vertex_y[v];
+		r[2] = vertex_z[v];
+	};
+
+	// panels in Morton order of their centroids, so neighbouring panels share a block
+	double low[3] = { 1e300, 1e300, 1e300 };
+	double high[3] = { -1e300, -1e300, -1e300 };
+	for (int v = 0; v < num_vertices; v++) {
+		double r[3];
+		corner_pos(v, r);
+		for (int i = 0; i < 3; i++) {
+			low[i] = std::min(low[i], r[i]);
+			high[i] = std::max(high[i], r[i]);
+		}
+	}
+	std::vector<std::pair<uint32_t, int>> order(num_panels);
+	for (int p = 0; p < num_panels; p++) {
+		uint32_t key = 0;
+		for (int i = 0; i < 3; i++) {
+			double c = (vertices[3 * triangles[3 * p] + i] + vertices[3 * triangles[3 * p + 1] + i] + vertices[3 * triangles[3 * p + 2] + i]) / 3 - origin[i];
+			double scaled = high[i] > low[i] ? (c - low[i]) / (high[i] - low[i]) : 0;
+			uint32_t cell = (uint32_t)std::min(1023.0, std::max(0.0, scaled * 1024));
+			for (int bit = 0; bit < 10; bit++) {
+				key |= ((cell >> bit) & 1u) << (3 * bit + i);
+			}
+		}
+		order[p] = std::make_pair(key, p);
+	}
+	std::sort(order.begin(), order.end());
+	for (int k = 0; k < 3; k++) {
+		corner[k].resize(num_panels);
+		for (int p = 0; p < num_panels; p++) {
+			corner[k][p] = triangles[3 * order[p].second + k];
+		}
+	}
+
+	// enclosed volume from the divergence theorem, negative for inward normals
+	double r[3][3], c[3], e1[3], e2[3], a[3];
+	for (int p = 0; p < num_panels; p++) {
+		for (int k = 0; k < 3; k++) {
+			corner_pos(corner[k][p], r[k]);
+		}
+		for (int i = 0; i < 3; i++) {
+			e1[i] = r[1][i] - r[0][i];
+			e2[i] = r[2][i] - r[0][i];
+			c[i] = (r[0][i] + r[1][i] + r[2][i]) / 3;
+		}
+		Cross(e1, e2, a);
+		volume += (c[0] * a[0] + c[1] * a[1] + c[2] * a[2]) / 6;
+	}
+	if (volume < 0) {
+		std::swap(corner[1], corner[2]);
+		volume = -volume;
+	}
+
+	panel_integrals.resize((size_t)num_panels * kNumIntegrals);
+	centroid_x.resize(num_panels);
+	centroid_y.resize(num_panels);
+	centroid_z.resize(num_panels);
+	panel_radius.resize(num_panels);
+	for (int p = 0; p < num_panels; p++) {
+		for (int k = 0; k < 3; k++) {
+			corner_pos(corner[k][p], r[k]);
+		}
+		for (int i = 0; i < 3; i++) {
+			e1[i] = r[1][i] - r[0][i];
+			e2[i] = r[2][i] - r[0][i];
+			c[i] = (r[0][i] + r[1][i] + r[2][i]) / 3;
+		}
+		centroid_x[p] = c[0];
+		centroid_y[p] = c[1];
+		centroid_z[p] = c[2];
+		double radius_squared = 0;
+		for (int k = 0; k < 3; k++) {
+			radius_squared = std::max(radius_squared, (r[k][0] - c[0]) * (r[k][0] - c[0]) + (r[k][1] - c[1]) * (r[k][1] - c[1]) + (r[k][2] - c[2]) * (r[k][2] - c[2]));
+		}
+		// a little margin so rounding of the rotated centroid can't misclassify a panel touching its sphere
+		panel_radius[p] = std::sqrt(radius_squared) * (1 + 1e-9) + 1e-12;
+		Cross(e1, e2, a);
+		double* integrals = &panel_integrals[(size_t)p * kNumIntegrals];
+		for (int i = 0; i < 3; i++) {
+			a[i] *= 0.5;
+			integrals[i] = a[i];
+		}
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				integrals[3 + 3 * i + j] = a[i] * c[j];
+			}
+		}
+		Cross(c, a, integrals + 12);
+		double second_moment[3][3];
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				second_moment[i][j] = (r[0][i] * r[0][j] + r[1][i] * r[1][j] + r[2][i] * r[2][j] + 9 * c[i] * c[j]) / 12;
+			}
+		}
+		for (int j = 0; j < 3; j++) {
+			double col[3] = { second_moment[0][j], second_moment[1][j], second_moment[2][j] };
+			double t[3];
+			Cross(a, col, t);
+			for (int i = 0; i < 3; i++) {
+				integrals[15 + 3 * i + j] = -t[i];
+			}
+		}
+	}
+
+	// bounding spheres (around the corners' bounding box center) and summed integrals of the blocks
+	int num_blocks = (num_panels + kBlockPanels - 1) / kBlockPanels;
+	block_x.resize(num_blocks);
+	block_y.resize(num_blocks);
+	block_z.resize(num_blocks);
+	block_radius.resize(num_blocks);
+	block_integrals.assign((size_t)num_blocks * kNumIntegrals, 0.0);
+	for (int block = 0; block < num_blocks; block++) {
+		int begin = block * kBlockPanels;
+		int end = std::min(begin + kBlockPanels, num_panels);
+		double box_low[3] = { 1e300, 1e300, 1e300 };
+		double box_high[3] = { -1e300, -1e300, -1e300 };
+		for (int p = begin; p < end; p++) {
+			for (int k = 0; k < 3; k++) {
+				corner_pos(corner[k][p], r[k]);
+				for (int i = 0; i < 3; i++) {
+					box_low[i] = std::min(box_low[i], r[k][i]);
+					box_high[i] = std::max(box_high[i], r[k][i]);
+				}
+			}
+			for (int i = 0; i < kNumIntegrals; i++) {
+				block_integrals[(size_t)block * kNumIntegrals + i] += panel_integrals[(size_t)p * kNumIntegrals + i];
+			}
+		}
+		for (int i = 0; i < 3; i++) {
+			c[i] = (box_low[i] + box_high[i]) / 2;
+		}
+		double radius_squared = 0;
+		for (int p = begin; p < end; p++) {
+			for (int k = 0; k < 3; k++) {
+				corner_pos(corner[k][p], r[k]);
+				radius_squared = std::max(radius_squared, (r[k][0] - c[0]) * (r[k][0] - c[0]) + (r[k][1] - c[1]) * (r[k][1] - c[1]) + (r[k][2] - c[2]) * (r[k][2] - c[2]));
+			}
+		}
+		block_x[block] = c[0];
+		block_y[block] = c[1];
+		block_z[block] = c[2];
+		block_radius[block] = std::sqrt(radius_squared) * (1 + 1e-9) + 1e-12;
+	}
+
+	// every edge of a closed mesh is shared by exactly two panels
+	std::vector<std::pair<int, int>> edges;
+	edges.reserve(3 * (size_t)num_panels);
+	for (int p = 0; p < num_panels; p++) {
+		for (int k = 0; k < 3; k++) {
+			int v0 = corner[k][p];
+			int v1 = corner[(k + 1) % 3][p];
+			edges.push_back(std::make_pair(std::min(v0, v1), std::max(v0, v1)));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t e = 0; e < edges.size(); ) {
+		size_t same = e + 1;
+		while (same < edges.size() && edges[same] == edges[e]) {
+			same++;
+		}
+		num_open_edges += same - e == 1 ? 1 : 0;
+		e = same;
+	}
+
+	block_state.assign(num_blocks, -1);
+	new_state.assign(num_blocks, -1);
+	waterline_blocks.reserve(num_blocks);
+	block_partials.resize((size_t)num_blocks * kNumPartials);
+	block_clipped.resize(num_blocks);
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::ReadObj()
+* reads the vertices (x y z) and faces of a Wavefront obj file, polygons are
+* split into triangle fans. Returns false if the file can't be read or has
+* no faces, and then says why in *error (if error isn't null)
+*******************************************************************************/
+bool NonlinearHydrostatics::ReadObj(std::string file, std::vector<double>& vertices, std::vector<int>& triangles, std::string* error) {
+	auto fail = [error](std::string message) {
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	};
+	std::ifstream in(file);
+	if (!in.is_open()) {
+		return fail("could not open mesh file " + file);
+	}
+	vertices.clear();
+	triangles.clear();
+	std::string line, tag, token;
+	std::vector<int> face;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		if (!(fields >> tag)) {
+			continue;
+		}
+		if (tag == "v") {
+			double x = 0, y = 0, z = 0;
+			fields >> x >> y >> z;
+			vertices.insert(vertices.end(), { x, y, z });
+		}
+		else if (tag == "f") {
+			// "v", "v/vt", "v//vn" or "v/vt/vn", indices from 1, negative ones count back from the last vertex
+			face.clear();
+			int num_vertices = (int)vertices.size() / 3;
+			while (fields >> token) {
+				int index = std::atoi(token.c_str());
+				index = index < 0 ? num_vertices + index : index - 1;
+				if (index < 0 || index >= num_vertices) {
+					return fail("mesh file " + file + " has a face with an invalid vertex index");
+				}
+				face.push_back(index);
+			}
+			for (size_t k = 2; k < face.size(); k++) {
+				triangles.insert(triangles.end(), { face[0], face[k - 1], face[k] });
+			}
+		}
+	}
+	if (triangles.empty()) {
+		return fail("mesh file " + file + " has no faces");
+	}
+	return true;
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::SumWetBlocks()
+* wet_sums from scratch, drops the rounding error the incremental updates collect
+*******************************************************************************/
+void NonlinearHydrostatics::SumWetBlocks() {
+	std::fill(wet_sums, wet_sums + kNumIntegrals, 0.0);
+	for (int block = 0; block < (int)block_state.size(); block++) {
+		if (block_state[block] == 1) {
+			const double* integrals = &block_integrals[(size_t)block * kNumIntegrals];
+			for (int i = 0; i < kNumIntegrals; i++) {
+				wet_sums[i] += integrals[i];
+			}
+		}
+	}
+	num_updates = 0;
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::SaveState()
+* appends the block states and the running wet block sums to out. The sums
+* are updated incrementally, restoring them (instead of summing from scratch)
+* keeps the rounding of the following steps unchanged
+*******************************************************************************/
+void NonlinearHydrostatics::SaveState(StateWriter& out) const {
+	out.Write(num_updates);
+	out.Write(num_clipped);
+	out.WriteArray(wet_sums, kNumIntegrals);
+	out.Write(block_state);
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::RestoreState()
+* reads back what SaveState() wrote, the mesh must have the same blocks
+* returns false if it doesn't
+*******************************************************************************/
+bool NonlinearHydrostatics::RestoreState(StateReader& in) {
+	return in.Read(num_updates) && in.Read(num_clipped) && in.ReadArray(wet_sums, kNumIntegrals) && in.Read(block_state);
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::ComputeWaterlineBlock()
+* partials[0..23]: integrals of the block's fully wet panels, partials[24..29]:
+* integrals of z n and z d x n (absolute frame, about the body reference point)
+* over the wet part of its panels crossing the waterline, which are counted
+* in clipped. Panels are sorted out by their bounding sphere first, then by
+* their corner heights
+*******************************************************************************/
+void NonlinearHydrostatics::ComputeWaterlineBlock(int block, double pos_z, const double rot[9], double* partials, int* clipped) const {
+	// local sums, partials could alias the panel data as far as the compiler knows
+	double sums[kNumPartials] = {};
+	*clipped = 0;
+	int begin = block * kBlockPanels;
+	int end = std::min(begin + kBlockPanels, GetNumPanels());
+	double r20 = rot[6], r21 = rot[7], r22 = rot[8];
+	auto height = [&](int v) { return pos_z + r20 * vertex_x[v] + r21 * vertex_y[v] + r22 * vertex_z[v]; };
+	for (int p = begin; p < end; p++) {
+		double h = pos_z + r20 * centroid_x[p] + r21 * centroid_y[p] + r22 * centroid_z[p];
+		if (h - panel_radius[p] >= 0) {
+			continue;
+		}
+		int v[3] = { corner[0][p], corner[1][p], corner[2][p] };
+		double hv[3] = { height(v[0]), height(v[1]), height(v[2]) };
+		if (h + panel_radius[p] <= 0 || std::max(hv[0], std::max(hv[1], hv[2])) <= 0) {
+			const double* integrals = &panel_integrals[(size_t)p * kNumIntegrals];
+			for (int i = 0; i < kNumIntegrals; i++) {
+				sums[i] += integrals[i];
+			}
+			continue;
+		}
+		if (std::min(hv[0], std::min(hv[1], hv[2])) >= 0) {
+			continue;
+		}
+		(*clipped)++;
+		double d[3][3];
+		for (int k = 0; k < 3; k++) {
+			for (int i = 0; i < 3; i++) {
+				d[k][i] = rot[3 * i] * vertex_x[v[k]] + rot[3 * i + 1] * vertex_y[v[k]] + rot[3 * i + 2] * vertex_z[v[k]];
+			}
+		}
+		// the wet part of a triangle cut by a plane has 3 or 4 corners
+		double poly[4][3];
+		double poly_h[4];
+		int num_poly = 0;
+		for (int k = 0; k < 3; k++) {
+			int next = (k + 1) % 3;
+			if (hv[k] <= 0) {
+				std::copy(d[k], d[k] + 3, poly[num_poly]);
+				poly_h[num_poly++] = hv[k];
+			}
+			if ((hv[k] < 0 && hv[next] > 0) || (hv[k] > 0 && hv[next] < 0)) {
+				double t = hv[k] / (hv[k] - hv[next]);
+				for (int i = 0; i < 3; i++) {
+					poly[num_poly][i] = d[k][i] + t * (d[next][i] - d[k][i]);
+				}
+				poly_h[num_poly++] = 0;
+			}
+		}
+		for (int k = 2; k < num_poly; k++) {
+			AddTriangle(poly[0], poly[k - 1], poly[k], poly_h[0], poly_h[k - 1], poly_h[k], sums + kNumIntegrals, sums + kNumIntegrals + 3);
+		}
+	}
+	std::copy(sums, sums + kNumPartials, partials);
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::Compute()
+* force[0..5]: hydrostatic force and torque about pos (absolute frame) with the
+* body reference point at pos and rotation rot (3x3, row major, body to
+* absolute frame). Blocks are classified from their bounding spheres, wet_sums
+* follows the blocks that got wet or stopped being wet, blocks reaching the
+* waterline are evaluated panel by panel (in parallel for large meshes, summed
+* in block order so the result doesn't depend on the number of threads)
+*******************************************************************************/
+void NonlinearHydrostatics::Compute(const double pos[3], const double rot[9], double* force) {
+	int num_blocks = (int)block_state.size();
+	const double* bx = block_x.data();
+	const double* by = block_y.data();
+	const double* bz = block_z.data();
+	const double* radius = block_radius.data();
+	double pos_z = pos[2], r20 = rot[6], r21 = rot[7], r22 = rot[8];
+	signed char* state = new_state.data();
+	#pragma omp simd
+	for (int block = 0; block < num_blocks; block++) {
+		double h = pos_z + r20 * bx[block] + r21 * by[block] + r22 * bz[block];
+		// branch free for vectorization: 1 wet, -1 dry, else 2
+		state[block] = (signed char)(2 - (h + radius[block] <= 0) - 3 * (h - radius[block] >= 0));
+	}
+
+	waterline_blocks.clear();
+	for (int block = 0; block < num_blocks; block++) {
+		if (state[block] != block_state[block]) {
+			double sign = state[block] == 1 ? 1.0 : (block_state[block] == 1 ? -1.0 : 0.0);
+			if (sign != 0) {
+				const double* integrals = &block_integrals[(size_t)block * kNumIntegrals];
+				for (int i = 0; i < kNumIntegrals; i++) {
+					wet_sums[i] += sign * integrals[i];
+				}
+				num_updates++;
+			}
+			block_state[block] = state[block];
+		}
+		if (state[block] == 2) {
+			waterline_blocks.push_back(block);
+		}
+	}
+	if (num_updates > num_blocks) {
+		SumWetBlocks();
+	}
+
+	int num_waterline = (int)waterline_blocks.size();
+	auto compute_block = [&](int i) {
+		ComputeWaterlineBlock(waterline_blocks[i], pos_z, rot, &block_partials[(size_t)i * kNumPartials], &block_clipped[i]);
+	};
+	// serial below the threshold without entering the OpenMP runtime, see RadiationConvolution::Compute()
+	if ((long long)num_waterline * kBlockPanels >= kParallelMinPanels && GetNumParallelThreads() > 1) {
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < num_waterline; i++) {
+			compute_block(i);
+		}
+	}
+	else {
+		for (int i = 0; i < num_waterline; i++) {
+			compute_block(i);
+		}
+	}
+	double s[kNumIntegrals];
+	std::copy(wet_sums, wet_sums + kNumIntegrals, s);
+	double clipped_force[3] = { 0, 0, 0 };
+	double clipped_torque[3] = { 0, 0, 0 };
+	num_clipped = 0;
+	for (int i = 0; i < num_waterline; i++) {
+		const double* partials = &block_partials[(size_t)i * kNumPartials];
+		for (int j = 0; j < kNumIntegrals; j++) {
+			s[j] += partials[j];
+		}
+		for (int j = 0; j < 3; j++) {
+			clipped_force[j] += partials[kNumIntegrals + j];
+			clipped_torque[j] += partials[kNumIntegrals + 3 + j];
+		}
+		num_clipped += block_clipped[i];
+	}
+
+	// wet panels in the body frame, rotated to the absolute frame
+	double body_force[3], body_torque[3];
+	for (int i = 0; i < 3; i++) {
+		body_force[i] = pos_z * s[i] + s[3 + 3 * i] * r20 + s[4 + 3 * i] * r21 + s[5 + 3 * i] * r22;
+		body_torque[i] = pos_z * s[12 + i] + s[15 + 3 * i] * r20 + s[16 + 3 * i] * r21 + s[17 + 3 * i] * r22;
+	}
+	for (int i = 0; i < 3; i++) {
+		double f = rot[3 * i] * body_force[0] + rot[3 * i + 1] * body_force[1] + rot[3 * i + 2] * body_force[2];
+		double t = rot[3 * i] * body_torque[0] + rot[3 * i + 1] * body_torque[1] + rot[3 * i + 2] * body_torque[2];
+		force[i] = rho_g * (f + clipped_force[i]);
+		force[3 + i] = rho_g * (t + clipped_torque[i]);
+	}
+}
+
+/*******************************************************************************
+* NonlinearHydrostatics::GetNumBytes()
+* heap held by the mesh, its per panel and per block data
+*******************************************************************************/
+size_t NonlinearHydrostatics::GetNumBytes() const {
+	return sizeof(double) * (vertex_x.size() + vertex_y.size() + vertex_z.size() + centroid_x.size() + centroid_y.size() + centroid_z.size()
+		+ panel_radius.size() + panel_integrals.size() + block_x.size() + block_y.size() + block_z.size() + block_radius.size()
+		+ block_integrals.size() + block_partials.size())
+		+ sizeof(int) * (corner[0].size() + corner[1].size() + corner[2].size() + waterline_blocks.capacity() + block_clipped.size())
+		+ block_state.size() + new_state.size();
+}
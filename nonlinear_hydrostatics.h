@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "state_buffer.h"
+
+// =============================================================================
+// NonlinearHydrostatics
+// body exact hydrostatic force: the still water pressure -rho g z integrated
+// over the part of a closed triangle mesh below z = 0 at the body's current
+// position and rotation, instead of the linear stiffness matrix.
+// Panels are stored structure of arrays (vertex coordinates, corner indices,
+// centroids) plus per panel surface integrals, so a fully wet panel's
+// contribution is a linear function of the body's height and rotation.
+// Panels are sorted along a space filling curve and grouped in blocks of
+// kBlockPanels with a bounding sphere each. Blocks entirely below the
+// waterline contribute through the sum of their integrals, which is kept for
+// all fully wet blocks and only updated for blocks that got wet or stopped
+// being wet since the last evaluation. Only blocks reaching the waterline
+// look at their panels, and only panels crossing it are clipped.
+// =============================================================================
+class NonlinearHydrostatics {
+public:
+	NonlinearHydrostatics();
+	NonlinearHydrostatics(const std::vector<double>& vertices, const std::vector<int>& triangles, const double origin[3], double rho_g);
+	static bool ReadObj(std::string file, std::vector<double>& vertices, std::vector<int>& triangles, std::string* error = nullptr);
+	void Compute(const double pos[3], const double rot[9], double* force);
+	void SaveState(StateWriter& out) const;
+	bool RestoreState(StateReader& in);
+	int GetNumPanels() const { return (int)corner[0].size(); }
+	int GetNumVertices() const { return (int)vertex_x.size(); }
+	int GetNumClipped() const { return num_clipped; }
+	int GetNumOpenEdges() const { return num_open_edges; }
+	double GetVolume() const { return volume; }
+	size_t GetNumBytes() const;
+private:
+	static const int kNumIntegrals = 24;           ///< per panel: a, S, m, T, see the constructor
+	static const int kNumPartials = 30;            ///< per waterline block: wet integrals, clipped force and torque
+	static const int kBlockPanels = 32;
+	static const int kParallelMinPanels = 1 << 14; ///< smallest number of waterline panels processed in parallel
+	double rho_g;
+	double volume;                                 ///< enclosed volume of the mesh
+	int num_open_edges;                            ///< edges used by one triangle only, 0 for a closed mesh
+	int num_clipped;                               ///< panels crossing the waterline in the last Compute()
+	int num_updates;                               ///< blocks added to or removed from wet_sums since they were last summed from scratch
+	std::vector<double> vertex_x;                  ///< body frame, relative to the body reference point
+	std::vector<double> vertex_y;
+	std::vector<double> vertex_z;
+	std::vector<int> corner[3];                    ///< vertex index of each panel corner
+	std::vector<double> centroid_x;                ///< panel centroids, body frame
+	std::vector<double> centroid_y;
+	std::vector<double> centroid_z;
+	std::vector<double> panel_radius;              ///< largest distance from a panel's centroid to its corners
+	std::vector<double> panel_integrals;           ///< [panel][kNumIntegrals]
+	std::vector<double> block_x;                   ///< bounding sphere centers of the blocks, body frame
+	std::vector<double> block_y;
+	std::vector<double> block_z;
+	std::vector<double> block_radius;
+	std::vector<double> block_integrals;           ///< [block][kNumIntegrals], sum over the block's panels
+	std::vector<signed char> block_state;          ///< 1 wet, -1 dry, 2 reaching the waterline, last Compute()
+	std::vector<signed char> new_state;
+	std::vector<int> waterline_blocks;             ///< blocks with state 2, preallocated
+	std::vector<double> block_partials;            ///< [waterline block][kNumPartials], preallocated
+	std::vector<int> block_clipped;                ///< clipped panels per waterline block
+	double wet_sums[kNumIntegrals];                ///< block_integrals summed over the blocks with state 1
+	void SumWetBlocks();
+	void ComputeWaterlineBlock(int block, double pos_z, const double rot[9], double* partials, int* clipped) const;
+};
@@ -0,0 +1,296 @@
+#include "radiation_convolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+// =============================================================================
+// RIRF Preprocessing Definitions
+// =============================================================================
+
+/*******************************************************************************
+* ResampleRIRF()
+* linearly interpolates num_entries RIRF entries ([entry][step], sampled at
+* rirf_time_vector) onto the uniform grid t0, t0 + dt, ... up to the last RIRF
+* time, so that one step of the kernel matches one simulation step of the
+* convolution history. Returns the resampled entries ([entry][step]) and sets
+* resampled_time_vector to the new grid
+*******************************************************************************/
+std::vector<double> ResampleRIRF(const std::vector<double>& rirf, int num_entries, const std::vector<double>& rirf_time_vector, double dt,
+	std::vector<double>& resampled_time_vector) {
+	int num_steps = (int)rirf_time_vector.size();
+	if (num_steps < 2 || dt <= 0.0) {
+		resampled_time_vector = rirf_time_vector;
+		return rirf;
+	}
+	double t0 = rirf_time_vector[0];
+	double duration = rirf_time_vector[num_steps - 1] - t0;
+	// tolerate round off in the last RIRF time so an exact multiple of dt keeps its last sample
+	int new_steps = (int)std::floor(duration / dt * (1.0 + 1e-12)) + 1;
+	resampled_time_vector.resize(new_steps);
+	// source interval and interpolation weight of each new sample, shared by all entries
+	std::vector<int> interval(new_steps);
+	std::vector<double> fraction(new_steps);
+	int i = 0;
+	for (int st = 0; st < new_steps; st++) {
+		double t = std::min(t0 + st * dt, rirf_time_vector[num_steps - 1]);
+		resampled_time_vector[st] = t;
+		while (i < num_steps - 2 && rirf_time_vector[i + 1] < t) {
+			i++;
+		}
+		double width = rirf_time_vector[i + 1] - rirf_time_vector[i];
+		interval[st] = i;
+		fraction[st] = width > 0.0 ? std::min(std::max((t - rirf_time_vector[i]) / width, 0.0), 1.0) : 0.0;
+	}
+	std::vector<double> resampled((size_t)num_entries * new_steps);
+	for (int entry = 0; entry < num_entries; entry++) {
+		const double* src = &rirf[(size_t)entry * num_steps];
+		double* dst = &resampled[(size_t)entry * new_steps];
+		for (int st = 0; st < new_steps; st++) {
+			const double* k = src + interval[st];
+			dst[st] = fraction[st] == 0.0 ? k[0] : k[0] + fraction[st] * (k[1] - k[0]);
+		}
+	}
+	return resampled;
+}
+
+// =============================================================================
+// RadiationConvolution Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* RadiationConvolution default constructor
+* empty kernel, Compute() does nothing
+*******************************************************************************/
+RadiationConvolution::RadiationConvolution() : num_rows(0), num_cols(0), num_steps(0), full_steps(0), num_entries(0), offset(0), dot(GetDotKernel()) {}
+
+/*******************************************************************************
+* RadiationConvolution constructor
+* rirf is the rows x cols x steps RIRF laid out as in the h5 file
+* ([row][col][step]) and already scaled by rho, sampled at rirf_time_vector
+* (see ResampleRIRF() to match it to the simulation step). Each entry is
+* copied column major, so that all rows sharing a column's velocity history
+* are adjacent in memory, and the trapezoid weights of the (possibly
+* nonuniform) rirf_time_vector are folded in, so the integral becomes a plain
+* dot product per (row, col) pair.
+* An entry keeps the shortest length whose dropped tail holds at most
+* truncation_tolerance of the entry's energy (sum of K^2). With the default 0
+* only trailing zeros are dropped, which doesn't change the result, and
+* entries that are zero everywhere (uncoupled DOFs) are skipped by Compute()
+*******************************************************************************/
+RadiationConvolution::RadiationConvolution(int rows, int cols, const std::vector<double>& rirf, const std::vector<double>& rirf_time_vector, double truncation_tolerance)
+	: dot(GetDotKernel()) {
+	num_rows = rows;
+	num_cols = cols;
+	full_steps = (int)rirf_time_vector.size();
+
+	// trapezoid rule: interior samples get half of each neighbouring interval,
+	// the two end samples get half of their single interval
+	std::vector<double> weights(full_steps, 0.0);
+	for (int st = 1; st < full_steps; st++) {
+		double half_dt = 0.5 * (rirf_time_vector[st] - rirf_time_vector[st - 1]);
+		weights[st - 1] += half_dt;
+		weights[st] += half_dt;
+	}
+
+	// per entry length: walk back from the end while the tail energy stays within tolerance
+	entry_length.assign((size_t)num_cols * num_rows, 0);
+	entry_start.assign((size_t)num_cols * num_rows, 0);
+	num_steps = 0;
+	num_entries = 0;
+	size_t num_taps = 0;
+	for (int col = 0; col < num_cols; col++) {
+		for (int row = 0; row < num_rows; row++) {
+			const double* src = &rirf[((size_t)row * num_cols + col) * full_steps];
+			double energy = 0.0;
+			for (int st = 0; st < full_steps; st++) {
+				energy += src[st] * src[st];
+			}
+			int length = full_steps;
+			double tail = 0.0;
+			while (length > 0) {
+				double next_tail = tail + src[length - 1] * src[length - 1];
+				if (src[length - 1] != 0.0 && next_tail > truncation_tolerance * energy) {
+					break;
+				}
+				tail = next_tail;
+				length--;
+			}
+			size_t entry = (size_t)col * num_rows + row;
+			entry_length[entry] = length;
+			entry_start[entry] = num_taps;
+			num_taps += length;
+			num_steps = std::max(num_steps, length);
+			num_entries += length > 0 ? 1 : 0;
+		}
+	}
+
+	// keep one slot even if every entry is zero, SetVelocity() always writes the newest sample
+	num_steps = std::max(num_steps, num_cols > 0 ? 1 : 0);
+	kernel.resize(num_taps);
+	for (int col = 0; col < num_cols; col++) {
+		for (int row = 0; row < num_rows; row++) {
+			size_t entry = (size_t)col * num_rows + row;
+			const double* src = &rirf[((size_t)row * num_cols + col) * full_steps];
+			double* k = &kernel[entry_start[entry]];
+			for (int st = 0; st < entry_length[entry]; st++) {
+				k[st] = src[st] * weights[st];
+			}
+		}
+	}
+	velocity_history.resize((size_t)num_cols * num_steps);
+	Reset();
+}
+
+/*******************************************************************************
+* RadiationConvolution::Reset()
+* zeros the velocity history, as at the start of a simulation
+*******************************************************************************/
+void RadiationConvolution::Reset() {
+	std::fill(velocity_history.begin(), velocity_history.end(), 0.0);
+	offset = 0;
+}
+
+/*******************************************************************************
+* RadiationConvolution::Advance()
+* moves the ring buffer one step back in time, the slot freed up becomes the
+* newest sample and is zeroed until set with SetVelocity()
+*******************************************************************************/
+void RadiationConvolution::Advance() {
+	if (num_steps == 0) {
+		return;
+	}
+	offset--;
+	if (offset < 0) {
+		offset += num_steps;
+	}
+	for (int col = 0; col < num_cols; col++) {
+		velocity_history[(size_t)col * num_steps + offset] = 0.0;
+	}
+}
+
+/*******************************************************************************
+* RadiationConvolution::SetVelocity()
+* sets the newest velocity sample of column col
+*******************************************************************************/
+void RadiationConvolution::SetVelocity(int col, double val) {
+	velocity_history[(size_t)col * num_steps + offset] = val;
+}
+
+/*******************************************************************************
+* RadiationConvolution::SetPastVelocity()
+* sets the velocity of column col steps_ago steps before the newest sample,
+* for starting from a known motion instead of from rest
+*******************************************************************************/
+void RadiationConvolution::SetPastVelocity(int col, int steps_ago, double val) {
+	velocity_history[(size_t)col * num_steps + (offset + steps_ago) % num_steps] = val;
+}
+
+/*******************************************************************************
+* RadiationConvolution::SaveState()
+* appends the velocity history and the ring buffer offset to out
+*******************************************************************************/
+void RadiationConvolution::SaveState(StateWriter& out) const {
+	out.Write(offset);
+	out.Write(velocity_history);
+}
+
+/*******************************************************************************
+* RadiationConvolution::RestoreState()
+* reads back what SaveState() wrote, the history must have the same length
+* returns false (leaving the history undefined) if it doesn't
+*******************************************************************************/
+bool RadiationConvolution::RestoreState(StateReader& in) {
+	return in.Read(offset) && in.Read(velocity_history) && offset >= 0 && offset < std::max(num_steps, 1);
+}
+
+/*******************************************************************************
+* RadiationConvolution::GetKernelName()
+* returns the instruction set of the dot product kernel selected at runtime
+* ("avx512", "avx2" or "scalar")
+*******************************************************************************/
+const char* RadiationConvolution::GetKernelName() {
+	return GetDotKernelName();
+}
+
+/*******************************************************************************
+* RadiationConvolution::GetNumBytes()
+* kernel, history and entry tables
+*******************************************************************************/
+size_t RadiationConvolution::GetNumBytes() const {
+	return sizeof(double) * (kernel.size() + velocity_history.size()) + (sizeof(size_t) + sizeof(int)) * entry_length.size();
+}
+
+/*******************************************************************************
+* RadiationConvolution::PrintReport()
+* number of entries and kernel taps kept against the full rows x cols x steps
+* kernel, and the kept length of every entry
+*******************************************************************************/
+void RadiationConvolution::PrintReport(std::ostream& out) const {
+	long long full_taps = (long long)num_rows * num_cols * full_steps;
+	out << "RIRF convolution: " << num_entries << " of " << num_rows * num_cols << " entries, " << GetNumTaps() << " of " << full_taps
+		<< " kernel steps (" << (full_taps > 0 ? 100.0 * GetNumTaps() / full_taps : 0.0) << "%), history " << num_steps << " of " << full_steps << " steps\n";
+	out << "  steps kept per entry (row, col):\n";
+	for (int row = 0; row < num_rows; row++) {
+		out << "   ";
+		for (int col = 0; col < num_cols; col++) {
+			out << " " << std::setw(6) << GetLength(row, col);
+		}
+		out << "\n";
+	}
+}
+
+/*******************************************************************************
+* RadiationConvolution::Compute()
+* writes num_rows radiation force components into force
+* rows are split into blocks of kRowBlock (one body's DOFs), see ComputeBlock().
+* Blocks are independent, large kernels (many bodies or long RIRFs) spread them
+* over OpenMP threads. Small kernels don't enter an OpenMP region at all:
+* even one serialized by an if clause goes through the OpenMP runtime, which
+* costs about as much as a whole single body convolution, and allocates when
+* it runs on one thread.
+* Each row sums its columns in the same order either way, so the force doesn't
+* depend on the number of threads
+*******************************************************************************/
+void RadiationConvolution::Compute(double* force) const {
+	int num_blocks = (num_rows + kRowBlock - 1) / kRowBlock;
+	if (GetNumTaps() >= kParallelMinWork && num_blocks > 1 && GetNumParallelThreads() > 1) {
+		#pragma omp parallel for schedule(dynamic)
+		for (int block = 0; block < num_blocks; block++) {
+			ComputeBlock(block * kRowBlock, force);
+		}
+		return;
+	}
+	for (int block = 0; block < num_blocks; block++) {
+		ComputeBlock(block * kRowBlock, force);
+	}
+}
+
+/*******************************************************************************
+* RadiationConvolution::ComputeBlock()
+* writes the force on rows row_begin .. row_begin + kRowBlock - 1
+* step st of the kernel pairs with velocity slot (offset + st) % num_steps, so
+* each column's history is walked as two contiguous spans:
+* [offset, num_steps) for st = 0 .. num_steps - offset - 1 and
+* [0, offset) for the remaining steps, both cut to the entry's length.
+* Columns are the outer loop: one column's history is reused from cache by the
+* block's rows while the kernel streams through once
+*******************************************************************************/
+void RadiationConvolution::ComputeBlock(int row_begin, double* force) const {
+	int row_end = std::min(row_begin + kRowBlock, num_rows);
+	int first_span = num_steps - offset;
+	std::fill(force + row_begin, force + row_end, 0.0);
+	for (int col = 0; col < num_cols; col++) {
+		const double* v = &velocity_history[(size_t)col * num_steps];
+		for (int row = row_begin; row < row_end; row++) {
+			size_t entry = (size_t)col * num_rows + row;
+			int length = entry_length[entry];
+			if (length == 0) {
+				continue;
+			}
+			const double* k = &kernel[entry_start[entry]];
+			int first = std::min(length, first_span);
+			force[row] -= dot(k, v + offset, first) + dot(k + first, v, length - first);
+		}
+	}
+}
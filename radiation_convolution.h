@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "simd_kernels.h"
+#include "state_buffer.h"
+
+// =============================================================================
+// RIRF preprocessing
+// =============================================================================
+std::vector<double> ResampleRIRF(const std::vector<double>& rirf, int num_entries, const std::vector<double>& rirf_time_vector, double dt,
+	std::vector<double>& resampled_time_vector);
+
+// =============================================================================
+// RadiationConvolution
+// evaluates the radiation damping convolution integral
+//   F(t) = -integral_0^T K(tau) v(t - tau) dtau
+// with the RIRF kernel stored contiguously per (row, col) pair, already scaled
+// by rho and by the trapezoid weights of rirf_time_vector, and a preallocated
+// ring buffer of past velocities (one contiguous history per column).
+// For coupled bodies the rows of all bodies are stacked (6N x 6N kernel) and
+// share one velocity history, so the force is one matrix-times-history product.
+// Each (row, col) entry keeps only as many steps as it needs: entries that are
+// identically zero are dropped, the others are cut where the energy left in
+// their tail falls below truncation_tolerance of their total energy. The
+// history is as long as the longest entry.
+// No heap allocation happens after construction. The per (row, col) dot
+// products use the widest SIMD kernel the host cpu supports, and blocks of
+// rows are evaluated in parallel (OpenMP) once the kernel is large enough.
+// =============================================================================
+class RadiationConvolution {
+public:
+	RadiationConvolution();
+	RadiationConvolution(int rows, int cols, const std::vector<double>& rirf, const std::vector<double>& rirf_time_vector, double truncation_tolerance = 0.0);
+	void Reset();
+	void Advance();
+	void SetVelocity(int col, double val);
+	void SetPastVelocity(int col, int steps_ago, double val);
+	void Compute(double* force) const;
+	void SaveState(StateWriter& out) const;
+	bool RestoreState(StateReader& in);
+	int GetNumRows() const { return num_rows; }
+	int GetNumCols() const { return num_cols; }
+	int GetNumSteps() const { return num_steps; }
+	int GetLength(int row, int col) const { return entry_length[(size_t)col * num_rows + row]; }
+	int GetNumEntries() const { return num_entries; }
+	long long GetNumTaps() const { return (long long)kernel.size(); }
+	size_t GetNumBytes() const;
+	void PrintReport(std::ostream& out) const;
+	static const char* GetKernelName();
+private:
+	void ComputeBlock(int row_begin, double* force) const;
+	static const int kRowBlock = 6;                    ///< rows per parallel task, one body
+	static const long long kParallelMinWork = 1 << 18; ///< smallest number of kernel taps run in parallel
+	int num_rows;
+	int num_cols;
+	int num_steps;                        ///< history length, longest entry
+	int full_steps;                       ///< RIRF length before truncation
+	int num_entries;                      ///< entries with a nonzero length
+	int offset;                           ///< ring buffer slot holding the newest velocity
+	std::vector<double> kernel;           ///< entries one after the other, column major, K * rho * trapezoid weight
+	std::vector<size_t> entry_start;      ///< [col][row], first kernel index of each entry
+	std::vector<int> entry_length;        ///< [col][row], steps kept, 0 for identically zero entries
+	std::vector<double> velocity_history; ///< [col][slot], ring buffer of past velocities
+	DotFunc dot;                          ///< dot product kernel picked at runtime (scalar, avx2 or avx512)
+};
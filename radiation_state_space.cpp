@@ -0,0 +1,335 @@
+#include "radiation_state_space.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include <Eigen/Dense>
+
+namespace {
+	const int kMaxHankelSize = 100; ///< largest Hankel matrix dimension used by the fit
+}
+
+// =============================================================================
+// RadiationStateSpace Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* RadiationStateSpace default constructor
+* no modes, Compute() returns zero force
+*******************************************************************************/
+RadiationStateSpace::RadiationStateSpace() : num_rows(0), num_cols(0), time_committed(0), time_pending(0), has_state(false), cached_dt(-1) {}
+
+/*******************************************************************************
+* RadiationStateSpace constructor
+* rirf is the rows x cols x steps RIRF laid out as in the h5 file
+* ([row][col][step]) and already scaled by rho. Each entry is resampled on a
+* uniform grid of the first rirf_time_vector interval and fitted with at most
+* max_order modes, stopping at the first order whose
+* relative L2 error is below tolerance. Entries that are identically zero get
+* no modes at all
+*******************************************************************************/
+RadiationStateSpace::RadiationStateSpace(int rows, int cols, const std::vector<double>& rirf, const std::vector<double>& rirf_time_vector, int max_order, double tolerance)
+	: RadiationStateSpace() {
+	num_rows = rows;
+	num_cols = cols;
+	int num_steps = (int)rirf_time_vector.size();
+	double dt = rirf_time_vector[1] - rirf_time_vector[0];
+	int num_samples = (int)std::floor((rirf_time_vector[num_steps - 1] - rirf_time_vector[0]) / dt + 1e-9) + 1;
+
+	order.assign(num_rows * num_cols, 0);
+	fit_error.assign(num_rows * num_cols, 0.0);
+	std::vector<double> samples(num_samples);
+	for (int row = 0; row < num_rows; row++) {
+		for (int col = 0; col < num_cols; col++) {
+			const double* k = &rirf[((size_t)row * num_cols + col) * num_steps];
+			// linear interpolation onto t0 + n * dt, in case rirf_time_vector is not uniform
+			int st = 0;
+			for (int n = 0; n < num_samples; n++) {
+				double t = rirf_time_vector[0] + n * dt;
+				while (st < num_steps - 2 && rirf_time_vector[st + 1] < t) {
+					st++;
+				}
+				double w = (t - rirf_time_vector[st]) / (rirf_time_vector[st + 1] - rirf_time_vector[st]);
+				w = std::min(std::max(w, 0.0), 1.0);
+				samples[n] = (1.0 - w) * k[st] + w * k[st + 1];
+			}
+			FitEntry(samples, dt, max_order, tolerance, row, col);
+		}
+	}
+	state_committed.assign(lambda.size(), 0.0);
+	state_pending.assign(lambda.size(), 0.0);
+	phi_exp.resize(lambda.size());
+	phi_v0.resize(lambda.size());
+	phi_v1.resize(lambda.size());
+	velocity_committed.assign(num_cols, 0.0);
+	velocity_pending.assign(num_cols, 0.0);
+}
+
+/*******************************************************************************
+* RadiationStateSpace::FitEntry()
+* eigensystem realization of one RIRF entry: the SVD of the Hankel matrix of
+* (possibly decimated) samples gives a balanced discrete realization (A, B, C)
+* of each candidate order, the eigenvalues of A become continuous poles and the
+* residues are then refit by least squares against all samples. Poles outside
+* the unit circle are reflected inside so the realization stays stable
+*******************************************************************************/
+void RadiationStateSpace::FitEntry(const std::vector<double>& samples, double dt, int max_order, double tolerance, int row, int col) {
+	int n = (int)samples.size();
+	Eigen::Map<const Eigen::VectorXd> h(samples.data(), n);
+	double norm = h.norm();
+	if (norm == 0.0) {
+		return;
+	}
+	int stride = std::max(1, (n + 2 * kMaxHankelSize - 1) / (2 * kMaxHankelSize));
+	int m = std::min((n - 1) / (2 * stride), kMaxHankelSize);
+	if (m < 2) {
+		return;
+	}
+	Eigen::MatrixXd H0(m, m), H1(m, m);
+	for (int i = 0; i < m; i++) {
+		for (int j = 0; j < m; j++) {
+			H0(i, j) = samples[(i + j) * stride];
+			H1(i, j) = samples[(i + j + 1) * stride];
+		}
+	}
+	Eigen::BDCSVD<Eigen::MatrixXd> svd(H0, Eigen::ComputeThinU | Eigen::ComputeThinV);
+	const Eigen::VectorXd& sigma = svd.singularValues();
+	double hankel_dt = stride * dt;
+
+	Eigen::VectorXd t(n);
+	for (int i = 0; i < n; i++) {
+		t[i] = i * dt;
+	}
+	Eigen::VectorXcd h_complex = h.cast<Complex>();
+
+	double best_error = 1.0;
+	Eigen::VectorXcd best_lambda, best_residue;
+	int top = std::min(max_order, m - 1);
+	for (int r = 1; r <= top; r++) {
+		if (sigma[r - 1] <= sigma[0] * 1e-12) {
+			break;
+		}
+		Eigen::VectorXd s_inv_sqrt = sigma.head(r).cwiseSqrt().cwiseInverse();
+		Eigen::MatrixXd A = s_inv_sqrt.asDiagonal() * svd.matrixU().leftCols(r).transpose() * H1 * svd.matrixV().leftCols(r) * s_inv_sqrt.asDiagonal();
+		Eigen::EigenSolver<Eigen::MatrixXd> eig(A);
+		Eigen::VectorXcd poles(r);
+		int num_poles = 0;
+		for (int k = 0; k < r; k++) {
+			Complex z = eig.eigenvalues()[k];
+			double mag = std::abs(z);
+			if (mag < 1e-12) {
+				continue;
+			}
+			if (mag >= 1.0) {
+				z /= mag * mag;
+			}
+			poles[num_poles++] = std::log(z) / hankel_dt;
+		}
+		if (num_poles == 0) {
+			continue;
+		}
+		poles.conservativeResize(num_poles);
+		Eigen::MatrixXcd basis(n, num_poles);
+		for (int k = 0; k < num_poles; k++) {
+			basis.col(k) = (poles[k] * t.cast<Complex>()).array().exp();
+		}
+		Eigen::VectorXcd residues = basis.colPivHouseholderQr().solve(h_complex);
+		double error = ((basis * residues).real() - h).norm() / norm;
+		if (error < best_error) {
+			best_error = error;
+			best_lambda = poles;
+			best_residue = residues;
+		}
+		if (best_error < tolerance) {
+			break;
+		}
+	}
+	if (best_lambda.size() == 0) {
+		fit_error[row * num_cols + col] = 1.0;
+		return;
+	}
+	for (int k = 0; k < best_lambda.size(); k++) {
+		lambda.push_back(best_lambda[k]);
+		residue.push_back(best_residue[k]);
+		mode_row.push_back(row);
+		mode_col.push_back(col);
+	}
+	order[row * num_cols + col] = (int)best_lambda.size();
+	fit_error[row * num_cols + col] = best_error;
+}
+
+/*******************************************************************************
+* RadiationStateSpace::GetNumBytes()
+* size of the per mode tables and states
+*******************************************************************************/
+size_t RadiationStateSpace::GetNumBytes() const {
+	return sizeof(Complex) * (lambda.size() + residue.size() + state_committed.size() + state_pending.size() + phi_exp.size() + phi_v0.size() + phi_v1.size())
+		+ sizeof(int) * (mode_row.size() + mode_col.size()) + sizeof(double) * (velocity_committed.size() + velocity_pending.size());
+}
+
+/*******************************************************************************
+* RadiationStateSpace::Reset()
+* zeros the mode states, as if the body had been at rest forever
+*******************************************************************************/
+void RadiationStateSpace::Reset() {
+	std::fill(state_committed.begin(), state_committed.end(), Complex(0.0));
+	std::fill(state_pending.begin(), state_pending.end(), Complex(0.0));
+	std::fill(velocity_committed.begin(), velocity_committed.end(), 0.0);
+	std::fill(velocity_pending.begin(), velocity_pending.end(), 0.0);
+	has_state = false;
+}
+
+/*******************************************************************************
+* RadiationStateSpace::SetHarmonicState()
+* sets the mode states to their steady state for the velocities
+* v_j(t) = Re(V_j e^(i omega t)), V_j = velocity_amplitudes[j], at time:
+*   s_k = V/2 e^(i w t) / (i w - lambda_k) + conj(V)/2 e^(-i w t) / (-i w - lambda_k)
+* as if the bodies had been moving like that forever
+*******************************************************************************/
+void RadiationStateSpace::SetHarmonicState(double time, double omega, const Complex* velocity_amplitudes) {
+	Complex rotation = std::exp(Complex(0.0, omega * time));
+	for (size_t k = 0; k < lambda.size(); k++) {
+		Complex v = velocity_amplitudes[mode_col[k]];
+		state_committed[k] = 0.5 * v * rotation / (Complex(0.0, omega) - lambda[k]) + 0.5 * std::conj(v * rotation) / (Complex(0.0, -omega) - lambda[k]);
+	}
+	std::copy(state_committed.begin(), state_committed.end(), state_pending.begin());
+	for (int col = 0; col < num_cols; col++) {
+		velocity_committed[col] = (velocity_amplitudes[col] * rotation).real();
+		velocity_pending[col] = velocity_committed[col];
+	}
+	time_committed = time;
+	time_pending = time;
+	has_state = true;
+}
+
+/*******************************************************************************
+* RadiationStateSpace::SaveState()
+* appends the committed and pending mode states and velocities to out, the
+* discretization coefficients are not saved, they only depend on the step size
+*******************************************************************************/
+void RadiationStateSpace::SaveState(StateWriter& out) const {
+	out.Write(has_state);
+	out.Write(time_committed);
+	out.Write(time_pending);
+	out.Write(state_committed);
+	out.Write(state_pending);
+	out.Write(velocity_committed);
+	out.Write(velocity_pending);
+}
+
+/*******************************************************************************
+* RadiationStateSpace::RestoreState()
+* reads back what SaveState() wrote, the model must have the same modes
+* returns false if it doesn't
+*******************************************************************************/
+bool RadiationStateSpace::RestoreState(StateReader& in) {
+	cached_dt = -1;
+	return in.Read(has_state) && in.Read(time_committed) && in.Read(time_pending) && in.Read(state_committed) && in.Read(state_pending)
+		&& in.Read(velocity_committed) && in.Read(velocity_pending);
+}
+
+/*******************************************************************************
+* RadiationStateSpace::UpdateCoefficients()
+* exact integration of ds/dt = lambda s + v over a step dt with v linear
+* between its two end values v0, v1:
+*   s(dt) = exp(lambda dt) s(0) + phi_v0 v0 + phi_v1 v1
+* only recomputed when the step size changes
+*******************************************************************************/
+void RadiationStateSpace::UpdateCoefficients(double dt) {
+	if (dt == cached_dt) {
+		return;
+	}
+	cached_dt = dt;
+	for (size_t k = 0; k < lambda.size(); k++) {
+		Complex l = lambda[k];
+		Complex e = std::exp(l * dt);
+		Complex i0, i1;
+		if (std::abs(l * dt) < 1e-8) {
+			i0 = dt;
+			i1 = 0.5 * dt;
+		}
+		else {
+			i0 = (e - 1.0) / l;
+			i1 = -1.0 / l + (e - 1.0) / (l * l * dt);
+		}
+		phi_exp[k] = e;
+		phi_v0[k] = i0 - i1;
+		phi_v1[k] = i1;
+	}
+}
+
+/*******************************************************************************
+* RadiationStateSpace::Compute()
+* writes num_rows radiation force components into force for the num_cols
+* velocities at time. A later time accepts the previous evaluation as the new
+* starting point, evaluating the same time again (implicit iterations, state
+* perturbations) or any time back to the last accepted one recomputes from
+* that accepted state. Only one accepted state is kept, so a time before it
+* can't be evaluated: returns false, leaving the state and force untouched
+* (Reset(), RestoreState() or SetHarmonicState() to start over at that time)
+*******************************************************************************/
+bool RadiationStateSpace::Compute(double time, const double* velocity, double* force) {
+	if (has_state && time < time_committed) {
+		return false;
+	}
+	if (!has_state) {
+		time_committed = time;
+		time_pending = time;
+		has_state = true;
+	}
+	else if (time > time_pending) {
+		state_committed.swap(state_pending);
+		velocity_committed.swap(velocity_pending);
+		time_committed = time_pending;
+	}
+	time_pending = time;
+	std::copy(velocity, velocity + num_cols, velocity_pending.begin());
+	double dt = time - time_committed;
+	if (dt > 0.0) {
+		UpdateCoefficients(dt);
+		for (size_t k = 0; k < lambda.size(); k++) {
+			int col = mode_col[k];
+			state_pending[k] = phi_exp[k] * state_committed[k] + phi_v0[k] * velocity_committed[col] + phi_v1[k] * velocity[col];
+		}
+	}
+	else {
+		std::copy(state_committed.begin(), state_committed.end(), state_pending.begin());
+		if (time_committed == time_pending) {
+			std::copy(velocity, velocity + num_cols, velocity_committed.begin());
+		}
+	}
+	std::fill(force, force + num_rows, 0.0);
+	for (size_t k = 0; k < lambda.size(); k++) {
+		force[mode_row[k]] -= (residue[k] * state_pending[k]).real();
+	}
+	return true;
+}
+
+/*******************************************************************************
+* RadiationStateSpace::PrintFitReport()
+* per DOF (row) summary of the fit: total number of modes and worst relative
+* error over that row's nonzero entries, followed by the full error matrix
+*******************************************************************************/
+void RadiationStateSpace::PrintFitReport(std::ostream& out) const {
+	out << "RIRF state space fit (" << GetTotalOrder() << " modes total)\n";
+	for (int row = 0; row < num_rows; row++) {
+		int row_order = 0;
+		double worst = 0.0;
+		for (int col = 0; col < num_cols; col++) {
+			row_order += GetOrder(row, col);
+			worst = std::max(worst, GetFitError(row, col));
+		}
+		out << "  DOF " << row + 1 << ": order " << row_order << ", max relative error " << worst << "\n";
+	}
+	std::streamsize precision = out.precision();
+	out << "  relative error per entry (row, col):\n";
+	for (int row = 0; row < num_rows; row++) {
+		out << "   ";
+		for (int col = 0; col < num_cols; col++) {
+			out << " " << std::setw(10) << std::setprecision(3) << GetFitError(row, col);
+		}
+		out << "\n";
+	}
+	out.precision(precision);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <complex>
+#include <ostream>
+#include <vector>
+
+#include "state_buffer.h"
+
+// =============================================================================
+// RadiationStateSpace
+// approximates each RIRF entry K_ij(t) by a sum of damped complex exponentials
+//   K_ij(t) ~ Re( sum_k r_k exp(lambda_k t) )
+// fitted at load time with the eigensystem realization algorithm (SVD of the
+// Hankel matrix of RIRF samples). The radiation force then becomes a set of
+// first order ODEs ds_k/dt = lambda_k s_k + v_j(t), advanced exactly for a
+// piecewise linear velocity, so each step costs O(total order) instead of
+// O(36 * N_rirf).
+// =============================================================================
+class RadiationStateSpace {
+public:
+	RadiationStateSpace();
+	RadiationStateSpace(int rows, int cols, const std::vector<double>& rirf, const std::vector<double>& rirf_time_vector, int max_order, double tolerance);
+	void Reset();
+	bool Compute(double time, const double* velocity, double* force);
+	void SetHarmonicState(double time, double omega, const std::complex<double>* velocity_amplitudes);
+	void SaveState(StateWriter& out) const;
+	bool RestoreState(StateReader& in);
+	int GetNumRows() const { return num_rows; }
+	int GetNumCols() const { return num_cols; }
+	int GetOrder(int row, int col) const { return order[row * num_cols + col]; }
+	double GetFitError(int row, int col) const { return fit_error[row * num_cols + col]; }
+	int GetTotalOrder() const { return (int)lambda.size(); }
+	size_t GetNumBytes() const;
+	void PrintFitReport(std::ostream& out) const;
+private:
+	typedef std::complex<double> Complex;
+	int num_rows;
+	int num_cols;
+	std::vector<int> order;          ///< [row][col] number of modes used for each entry
+	std::vector<double> fit_error;   ///< [row][col] relative L2 error of the fit over the RIRF samples
+	// one entry per mode, all (row, col) pairs concatenated
+	std::vector<Complex> lambda;     ///< continuous time pole
+	std::vector<Complex> residue;    ///< already scaled by rho
+	std::vector<int> mode_row;
+	std::vector<int> mode_col;
+	// committed state is the accepted state at time_committed, pending state is the
+	// latest evaluation at time_pending, recomputed from committed if the solver
+	// evaluates the same time again
+	std::vector<Complex> state_committed;
+	std::vector<Complex> state_pending;
+	std::vector<double> velocity_committed;
+	std::vector<double> velocity_pending;
+	double time_committed;
+	double time_pending;
+	bool has_state;
+	// exact discretization coefficients for the last step size used
+	double cached_dt;
+	std::vector<Complex> phi_exp;
+	std::vector<Complex> phi_v0;
+	std::vector<Complex> phi_v1;
+	void FitEntry(const std::vector<double>& samples, double dt, int max_order, double tolerance, int row, int col);
+	void UpdateCoefficients(double dt);
+};
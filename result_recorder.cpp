@@ -0,0 +1,343 @@
+#include "result_recorder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "hydro_forces.h"
+
+namespace {
+	const char kRecorderMagic[8] = { 'H', 'C', 'R', 'E', 'S', 'U', '0', '1' };
+
+	struct RecorderHeader {
+		char magic[8];
+		uint32_t num_columns;
+		uint32_t chunk_rows;
+		uint32_t decimation;
+		uint32_t description_length;
+		uint32_t reserved[10];
+	};
+
+	static_assert(sizeof(RecorderHeader) == 64, "result file header must stay 64 bytes");
+
+	/*******************************************************************************
+	* WriteString()
+	* length (uint32) then the characters, no terminator
+	*******************************************************************************/
+	void WriteString(std::ofstream& stream, const std::string& text) {
+		uint32_t length = (uint32_t)text.size();
+		stream.write((const char*)&length, sizeof(length));
+		stream.write(text.data(), length);
+	}
+
+	/*******************************************************************************
+	* ReadString()
+	* reads a string written by WriteString()
+	*******************************************************************************/
+	bool ReadString(std::ifstream& stream, std::string& text) {
+		uint32_t length = 0;
+		if (!stream.read((char*)&length, sizeof(length))) {
+			return false;
+		}
+		text.resize(length);
+		return length == 0 || (bool)stream.read(&text[0], length);
+	}
+}
+
+// =============================================================================
+// ResultRecorder Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* ResultRecorder default constructor
+* not open, Record() does nothing
+*******************************************************************************/
+ResultRecorder::ResultRecorder()
+	: num_columns(0), decimation(1), num_calls(0), num_rows(0), filling(nullptr), filling_rows(0), closing(false), write_failed(false) {}
+
+/*******************************************************************************
+* ResultRecorder constructor
+* creates (overwrites) file_name with one column per name and starts the
+* writer thread. Only every decimation-th Record() call is kept, description
+* is free text stored in the file (written as # lines by ExportCsv()). If
+* file_name can't be created the recorder stays closed, see IsOpen()
+*******************************************************************************/
+ResultRecorder::ResultRecorder(std::string file, std::vector<std::string> column_names, int every_nth, std::string description)
+	: ResultRecorder() {
+	file_name = file;
+	num_columns = (int)column_names.size();
+	decimation = std::max(1, every_nth);
+	stream.open(file_name, std::ios::binary | std::ios::trunc);
+	if (!stream.is_open()) {
+		return;
+	}
+	RecorderHeader header = {};
+	std::memcpy(header.magic, kRecorderMagic, sizeof(kRecorderMagic));
+	header.num_columns = (uint32_t)num_columns;
+	header.chunk_rows = kChunkRows;
+	header.decimation = (uint32_t)decimation;
+	header.description_length = (uint32_t)description.size();
+	stream.write((const char*)&header, sizeof(header));
+	stream.write(description.data(), description.size());
+	for (const std::string& name : column_names) {
+		WriteString(stream, name);
+	}
+
+	buffers.resize(kNumBuffers);
+	for (std::vector<double>& buffer : buffers) {
+		buffer.resize((size_t)num_columns * kChunkRows);
+		free_chunks.push_back(&buffer);
+	}
+	filling = free_chunks.back();
+	free_chunks.pop_back();
+	writer = std::thread(&ResultRecorder::WriteChunks, this);
+}
+
+/*******************************************************************************
+* ResultRecorder destructor
+* writes what is left, see Close()
+*******************************************************************************/
+ResultRecorder::~ResultRecorder() {
+	Close();
+}
+
+/*******************************************************************************
+* ResultRecorder::Record()
+* appends one row, values[0 .. number of columns - 1], unless decimation skips it
+*******************************************************************************/
+void ResultRecorder::Record(const double* values) {
+	if (!IsOpen() || num_calls++ % decimation != 0) {
+		return;
+	}
+	double* chunk = filling->data();
+	for (int col = 0; col < num_columns; col++) {
+		chunk[(size_t)col * kChunkRows + filling_rows] = values[col];
+	}
+	filling_rows++;
+	num_rows++;
+	if (filling_rows == kChunkRows) {
+		SubmitChunk();
+	}
+}
+
+/*******************************************************************************
+* ResultRecorder::GetHydroColumnNames()
+* time, then per body position, velocity, angular velocity (absolute frame),
+* the total hydro force and torque and its hydrostatic (hs_), radiation
+* (rad_) and excitation (ex_) terms, matching RecordHydro()
+*******************************************************************************/
+std::vector<std::string> ResultRecorder::GetHydroColumnNames(int num_bodies) {
+	std::vector<std::string> names = { "time" };
+	for (int b = 0; b < num_bodies; b++) {
+		std::string body = "body" + std::to_string(b + 1) + "_";
+		for (std::string name : { "x", "y", "z", "vx", "vy", "vz", "wx", "wy", "wz" }) {
+			names.push_back(body + name);
+		}
+		for (std::string term : { "", "hs_", "rad_", "ex_" }) {
+			for (std::string name : { "fx", "fy", "fz", "tx", "ty", "tz" }) {
+				names.push_back(body + term + name);
+			}
+		}
+	}
+	return names;
+}
+
+/*******************************************************************************
+* ResultRecorder::RecordHydro()
+* records the row described by GetHydroColumnNames() for all bodies of
+* hydro_forces, the recorder must have been created with those columns,
+* other columns throw std::invalid_argument
+*******************************************************************************/
+void ResultRecorder::RecordHydro(const HydroForces& hydro_forces) {
+	if (!IsOpen()) {
+		return;
+	}
+	int num_bodies = hydro_forces.GetNumBodies();
+	if (num_columns != 1 + kHydroBodyColumns * num_bodies) {
+		throw std::invalid_argument("result file " + file_name + " has " + std::to_string(num_columns) + " columns, RecordHydro() needs "
+			+ std::to_string(1 + kHydroBodyColumns * num_bodies) + " for " + std::to_string(num_bodies) + " bodies (see GetHydroColumnNames())");
+	}
+	hydro_row.resize(num_columns);
+	double* val = hydro_row.data();
+	for (int b = 0; b < num_bodies; b++) {
+		HydroBodyState state = hydro_forces.GetBodyState(b);
+		ChVectorN<double, 6> forces[4] = { hydro_forces.GetForce(b), hydro_forces.GetForceHydrostatics(b),
+			hydro_forces.GetForceRadiationDamping(b), hydro_forces.GetForceExcitation(b) };
+		if (b == 0) {
+			*val++ = state.time;
+		}
+		for (int i = 0; i < 3; i++) {
+			val[i] = state.pos[i];
+			val[3 + i] = state.vel[i];
+			val[6 + i] = state.wvel[i];
+		}
+		for (int term = 0; term < 4; term++) {
+			for (int i = 0; i < 6; i++) {
+				val[9 + 6 * term + i] = forces[term][i];
+			}
+		}
+		val += kHydroBodyColumns;
+	}
+	Record(hydro_row.data());
+}
+
+/*******************************************************************************
+* ResultRecorder::SubmitChunk()
+* hands the filled chunk to the writer thread and takes a free one, waiting
+* only if every chunk is still queued for writing
+*******************************************************************************/
+void ResultRecorder::SubmitChunk() {
+	std::unique_lock<std::mutex> lock(chunk_mutex);
+	full_chunks.push_back(std::make_pair(filling, filling_rows));
+	chunk_condition.notify_all();
+	chunk_condition.wait(lock, [this]() { return !free_chunks.empty(); });
+	filling = free_chunks.back();
+	free_chunks.pop_back();
+	filling_rows = 0;
+}
+
+/*******************************************************************************
+* ResultRecorder::WriteChunks()
+* writer thread, writes queued chunks in order until Close()
+*******************************************************************************/
+void ResultRecorder::WriteChunks() {
+	std::unique_lock<std::mutex> lock(chunk_mutex);
+	while (true) {
+		chunk_condition.wait(lock, [this]() { return !full_chunks.empty() || closing; });
+		if (full_chunks.empty()) {
+			break;
+		}
+		std::pair<std::vector<double>*, int> chunk = full_chunks.front();
+		full_chunks.pop_front();
+		lock.unlock();
+		uint32_t rows[2] = { (uint32_t)chunk.second, 0 };
+		stream.write((const char*)rows, sizeof(rows));
+		for (int col = 0; col < num_columns; col++) {
+			stream.write((const char*)(chunk.first->data() + (size_t)col * kChunkRows), sizeof(double) * chunk.second);
+		}
+		lock.lock();
+		write_failed = write_failed || !stream.good();
+		free_chunks.push_back(chunk.first);
+		chunk_condition.notify_all();
+	}
+}
+
+/*******************************************************************************
+* ResultRecorder::Close()
+* queues the partly filled chunk, waits for the writer thread to write
+* everything and closes the file. Further Record() calls do nothing
+* returns false if anything couldn't be written
+*******************************************************************************/
+bool ResultRecorder::Close() {
+	if (!IsOpen()) {
+		return !write_failed;
+	}
+	{
+		std::lock_guard<std::mutex> lock(chunk_mutex);
+		if (filling_rows > 0) {
+			full_chunks.push_back(std::make_pair(filling, filling_rows));
+		}
+		closing = true;
+		chunk_condition.notify_all();
+	}
+	writer.join();
+	stream.close();
+	write_failed = write_failed || stream.fail();
+	return !write_failed;
+}
+
+/*******************************************************************************
+* ResultRecorder::Read()
+* reads a result file into its column names and one vector per column
+* returns false if the file can't be opened, isn't a result file or is
+* truncated, and then says why in *error (if error isn't null)
+*******************************************************************************/
+bool ResultRecorder::Read(std::string file, std::vector<std::string>& column_names, std::vector<std::vector<double>>& columns, std::string* description, std::string* error) {
+	auto fail = [error](std::string message) {
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	};
+	std::ifstream stream(file, std::ios::binary);
+	RecorderHeader header = {};
+	if (!stream.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, kRecorderMagic, sizeof(kRecorderMagic)) != 0) {
+		return fail(file + " is not a result file");
+	}
+	std::string text(header.description_length, '\0');
+	if (header.description_length > 0) {
+		stream.read(&text[0], header.description_length);
+	}
+	if (description != nullptr) {
+		*description = text;
+	}
+	column_names.resize(header.num_columns);
+	for (std::string& name : column_names) {
+		if (!ReadString(stream, name)) {
+			return fail(file + " is truncated");
+		}
+	}
+	columns.assign(header.num_columns, std::vector<double>());
+	uint32_t rows[2];
+	while (stream.read((char*)rows, sizeof(rows))) {
+		for (std::vector<double>& column : columns) {
+			size_t start = column.size();
+			column.resize(start + rows[0]);
+			if (!stream.read((char*)(column.data() + start), sizeof(double) * rows[0])) {
+				return fail(file + " is truncated");
+			}
+		}
+	}
+	return true;
+}
+
+/*******************************************************************************
+* ResultRecorder::ExportCsv()
+* writes result file file_name as csv: the description as # lines, a line of
+* column names, then one line per row at full double precision
+* returns false if file can't be read or the csv file written, and then says
+* why in *error (if error isn't null)
+*******************************************************************************/
+bool ResultRecorder::ExportCsv(std::string file, std::string csv_file_name, std::string* error) {
+	auto fail = [error](std::string message) {
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	};
+	std::vector<std::string> column_names;
+	std::vector<std::vector<double>> columns;
+	std::string description;
+	if (!Read(file, column_names, columns, &description, error)) {
+		return false;
+	}
+	std::FILE* csv = std::fopen(csv_file_name.c_str(), "w");
+	if (csv == nullptr) {
+		return fail("could not create " + csv_file_name);
+	}
+	size_t line_start = 0;
+	while (line_start < description.size()) {
+		size_t line_end = description.find('\n', line_start);
+		if (line_end == std::string::npos) {
+			line_end = description.size();
+		}
+		std::fprintf(csv, "# %s\n", description.substr(line_start, line_end - line_start).c_str());
+		line_start = line_end + 1;
+	}
+	for (size_t col = 0; col < column_names.size(); col++) {
+		std::fprintf(csv, "%s%s", col > 0 ? "," : "", column_names[col].c_str());
+	}
+	std::fprintf(csv, "\n");
+	size_t num_rows = columns.empty() ? 0 : columns[0].size();
+	for (size_t row = 0; row < num_rows; row++) {
+		for (size_t col = 0; col < columns.size(); col++) {
+			std::fprintf(csv, "%s%.17g", col > 0 ? "," : "", columns[col][row]);
+		}
+		std::fprintf(csv, "\n");
+	}
+	bool ok = std::ferror(csv) == 0;
+	if (std::fclose(csv) != 0 || !ok) {
+		return fail("could not write " + csv_file_name);
+	}
+	return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class HydroForces;
+
+// =============================================================================
+// ResultRecorder
+// records one row of doubles per simulation step into a binary result file.
+// Rows go into column major chunks of kChunkRows rows in memory, full chunks
+// are written by a background thread while the simulation keeps filling the
+// next one, so the step loop never formats text or waits on the disk (unless
+// all kNumBuffers chunks are waiting to be written). With decimation n only
+// every n-th row is kept.
+// File layout: 64 byte header, description text, column names, then chunks
+// of (row count, then each column's values of those rows), native endian.
+// Read() and ExportCsv() read it back, see also results_to_csv.
+// =============================================================================
+class ResultRecorder {
+public:
+	ResultRecorder();
+	ResultRecorder(std::string file_name, std::vector<std::string> column_names, int decimation = 1, std::string description = "");
+	ResultRecorder(const ResultRecorder& other) = delete;
+	ResultRecorder& operator = (const ResultRecorder& rhs) = delete;
+	~ResultRecorder();
+	void Record(const double* values);
+	void RecordHydro(const HydroForces& hydro_forces);
+	bool Close();
+	bool IsOpen() const { return writer.joinable(); }
+	int GetNumColumns() const { return num_columns; }
+	long long GetNumRows() const { return num_rows; }
+	static std::vector<std::string> GetHydroColumnNames(int num_bodies);
+	static bool Read(std::string file_name, std::vector<std::string>& column_names, std::vector<std::vector<double>>& columns, std::string* description = nullptr, std::string* error = nullptr);
+	static bool ExportCsv(std::string file_name, std::string csv_file_name, std::string* error = nullptr);
+private:
+	static const int kChunkRows = 4096;
+	static const int kHydroBodyColumns = 33;       ///< RecordHydro() columns per body
+	static const int kNumBuffers = 4;
+	void SubmitChunk();
+	void WriteChunks();
+	std::ofstream stream;                          ///< only used by the writer thread once it runs
+	std::string file_name;
+	int num_columns;
+	int decimation;
+	long long num_calls;                           ///< Record() calls, before decimation
+	long long num_rows;                            ///< rows kept
+	std::vector<double> hydro_row;                 ///< row buffer of RecordHydro()
+	std::vector<std::vector<double>> buffers;      ///< kNumBuffers chunks, [column][row]
+	std::vector<double>* filling;                  ///< chunk Record() writes to
+	int filling_rows;
+	std::deque<std::pair<std::vector<double>*, int>> full_chunks;  ///< chunks and their row counts waiting for the writer
+	std::vector<std::vector<double>*> free_chunks;
+	std::mutex chunk_mutex;
+	std::condition_variable chunk_condition;
+	bool closing;
+	bool write_failed;
+	std::thread writer;
+};
@@ -0,0 +1,20 @@
+#include "result_recorder.h"
+#include <iostream>
+
+// converts a binary result file written by ResultRecorder to csv, usage:
+//   results_to_csv <result file> [csv file]
+// without a csv file name the result file's name with .csv appended is used
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "usage: results_to_csv <result file> [csv file]\n";
+		return 1;
+	}
+	std::string csv_file = argc > 2 ? argv[2] : std::string(argv[1]) + ".csv";
+	std::string error;
+	if (!ResultRecorder::ExportCsv(argv[1], csv_file, &error)) {
+		std::cout << error << "\n";
+		return 1;
+	}
+	std::cout << "wrote " << csv_file << std::endl;
+	return 0;
+}
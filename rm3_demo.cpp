@@ -116,24 +116,17 @@ int main(int argc, char* argv[]) {
 	col_2->SetColor(ChColor(0, 0.7f, 0.8f));
 	plate_body2->AddAsset(col_2);
 
+	double timestep = 0.06; // also sets the timesteps in chrono system
 	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRadiationTimeStep(timestep); // resample the RIRF to the simulation step
 	my_hydro_inputs.SetRegularWaveAmplitude(0.022);
 	my_hydro_inputs.SetRegularWaveOmega(2.10);
 
 	std::vector<std::shared_ptr<ChBody>> bodies = { float_body1, plate_body2 };
-	//std::shared_ptr<ChLoadContainer> my_loadcontainer;
-	//std::shared_ptr<ChLoadAddedMass> my_loadbodyinertia;
-	//my_loadcontainer = chrono_types::make_shared<ChLoadContainer>();
-	//ChMatrixDynamic<> amMatrix;
-
-	//my_loadbodyinertia = chrono_types::make_shared<ChLoadAddedMass>(amMatrix, bodies);
-
-	//system.Add(my_loadcontainer);
-	//my_loadcontainer->Add(my_loadbodyinertia);
-	// TODO figure out better way for multibody
-	// TODO if body's name is correct, then we dont need the name field here...not sure if thats how we want to do this
-	LoadAllHydroForces hydroForcesTorus(float_body1, "../../HydroChrono/rm3.h5", float_body1->GetNameString(), my_hydro_inputs);
-	LoadAllHydroForces hydroForcesCylinder(plate_body2, "../../HydroChrono/rm3.h5", plate_body2->GetNameString(), my_hydro_inputs);
+	// both bodies share one hydro force object so their radiation is coupled, bodies are listed in h5 file order (body1, body2)
+	// it also adds their coupled infinite frequency added mass
+	LoadAllHydroForces hydroForces(bodies, "../../HydroChrono/rm3.h5", my_hydro_inputs);
+	hydroForces.GetHydroForces().PrintReport(std::cout);
 
 
 	// update irrlicht app with body info
@@ -149,7 +142,6 @@ int main(int argc, char* argv[]) {
 	auto gmres_solver = chrono_types::make_shared<ChSolverGMRES>();  // change to mkl or minres?
 	gmres_solver->SetMaxIterations(300);
 	system.SetSolver(gmres_solver);
-	double timestep = 0.06; // also sets the timesteps in chrono system
 	application.SetTimestep(timestep);
 
 	// set up output file for body position each step
@@ -171,7 +163,7 @@ int main(int argc, char* argv[]) {
 		tools::drawAllCOGs(system, application.GetVideoDriver(), 15); // draws all cog axis lines, kinda neat
 		//tools::drawGrid(application.GetVideoDriver(), 4, 4);
 		/*if (buttonPressed)*/if(true) {
-			zpos << system.GetChTime() << "\t" << float_body1->GetPos().z() << "\t" << float_body1->GetPos_dt().z() << "\t" << float_body1->GetAppliedForce().z() << "\n";
+			zpos << system.GetChTime() << "\t" << float_body1->GetPos().z() << "\t" << float_body1->GetPos_dt().z() << "\t" << hydroForces.GetForce(0)[2] << "\n";
 			application.DoStep();
 			frame++;
 		}
@@ -0,0 +1,207 @@
+#include "simd_kernels.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HYDROCHRONO_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// gcc and clang need the instruction set enabled per function to emit AVX code
+// without building the whole library with -mavx2, msvc accepts the intrinsics as is
+#if defined(__GNUC__) || defined(__clang__)
+#define HYDROCHRONO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define HYDROCHRONO_TARGET(isa)
+#endif
+
+// =============================================================================
+// Dot product kernels
+// =============================================================================
+
+namespace {
+	/*******************************************************************************
+	* DotScalar()
+	* portable fallback, 4 independent accumulators so the compiler can keep
+	* several multiplies in flight
+	*******************************************************************************/
+	double DotScalar(const double* k, const double* v, int n) {
+		double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			s0 += k[i] * v[i];
+			s1 += k[i + 1] * v[i + 1];
+			s2 += k[i + 2] * v[i + 2];
+			s3 += k[i + 3] * v[i + 3];
+		}
+		for (; i < n; i++) {
+			s0 += k[i] * v[i];
+		}
+		return (s0 + s1) + (s2 + s3);
+	}
+
+#ifdef HYDROCHRONO_X86
+	/*******************************************************************************
+	* DotAVX2()
+	* 4 lanes x 4 accumulators with fused multiply add, scalar tail
+	*******************************************************************************/
+	HYDROCHRONO_TARGET("avx2,fma")
+	double DotAVX2(const double* k, const double* v, int n) {
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		__m256d acc2 = _mm256_setzero_pd();
+		__m256d acc3 = _mm256_setzero_pd();
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(k + i), _mm256_loadu_pd(v + i), acc0);
+			acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(k + i + 4), _mm256_loadu_pd(v + i + 4), acc1);
+			acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(k + i + 8), _mm256_loadu_pd(v + i + 8), acc2);
+			acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(k + i + 12), _mm256_loadu_pd(v + i + 12), acc3);
+		}
+		for (; i + 4 <= n; i += 4) {
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(k + i), _mm256_loadu_pd(v + i), acc0);
+		}
+		__m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+		__m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+		double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+		for (; i < n; i++) {
+			sum += k[i] * v[i];
+		}
+		return sum;
+	}
+
+	/*******************************************************************************
+	* DotAVX512()
+	* 8 lanes x 4 accumulators, masked load for the tail
+	*******************************************************************************/
+	HYDROCHRONO_TARGET("avx512f")
+	double DotAVX512(const double* k, const double* v, int n) {
+		__m512d acc0 = _mm512_setzero_pd();
+		__m512d acc1 = _mm512_setzero_pd();
+		__m512d acc2 = _mm512_setzero_pd();
+		__m512d acc3 = _mm512_setzero_pd();
+		int i = 0;
+		for (; i + 32 <= n; i += 32) {
+			acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(k + i), _mm512_loadu_pd(v + i), acc0);
+			acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(k + i + 8), _mm512_loadu_pd(v + i + 8), acc1);
+			acc2 = _mm512_fmadd_pd(_mm512_loadu_pd(k + i + 16), _mm512_loadu_pd(v + i + 16), acc2);
+			acc3 = _mm512_fmadd_pd(_mm512_loadu_pd(k + i + 24), _mm512_loadu_pd(v + i + 24), acc3);
+		}
+		for (; i + 8 <= n; i += 8) {
+			acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(k + i), _mm512_loadu_pd(v + i), acc0);
+		}
+		if (i < n) {
+			__mmask8 tail = (__mmask8)((1u << (n - i)) - 1u);
+			acc1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, k + i), _mm512_maskz_loadu_pd(tail, v + i), acc1);
+		}
+		alignas(64) double lanes[8];
+		_mm512_store_pd(lanes, _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3)));
+		return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+	}
+
+	enum class SimdLevel { SCALAR, AVX2, AVX512 };
+
+	/*******************************************************************************
+	* DetectSimdLevel()
+	* runtime check that both the cpu and the os (saved register state) support
+	* the instruction set
+	*******************************************************************************/
+	SimdLevel DetectSimdLevel() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return SimdLevel::SCALAR;
+		}
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave) {
+			return SimdLevel::SCALAR;
+		}
+		unsigned long long xcr0 = _xgetbv(0);
+		bool ymm_enabled = (xcr0 & 0x6) == 0x6;
+		bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		bool avx512f = (info[1] & (1 << 16)) != 0;
+		if (avx512f && zmm_enabled) {
+			return SimdLevel::AVX512;
+		}
+		if (avx2 && fma && ymm_enabled) {
+			return SimdLevel::AVX2;
+		}
+		return SimdLevel::SCALAR;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) {
+			return SimdLevel::AVX512;
+		}
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+			return SimdLevel::AVX2;
+		}
+		return SimdLevel::SCALAR;
+#endif
+	}
+#endif
+
+	struct DotKernel {
+		DotFunc func;
+		const char* name;
+	};
+
+	/*******************************************************************************
+	* SelectDotKernel()
+	* picks the widest kernel the host supports, once per process
+	* (function local statics are initialized thread safely)
+	*******************************************************************************/
+	const DotKernel& SelectDotKernel() {
+		static const DotKernel kernel = []() -> DotKernel {
+#ifdef HYDROCHRONO_X86
+			switch (DetectSimdLevel()) {
+			case SimdLevel::AVX512:
+				return { DotAVX512, "avx512" };
+			case SimdLevel::AVX2:
+				return { DotAVX2, "avx2" };
+			default:
+				break;
+			}
+#endif
+			return { DotScalar, "scalar" };
+		}();
+		return kernel;
+	}
+}
+
+/*******************************************************************************
+* GetDotKernel()
+* returns the dot product kernel selected for this host
+*******************************************************************************/
+DotFunc GetDotKernel() {
+	return SelectDotKernel().func;
+}
+
+/*******************************************************************************
+* GetDotKernelName()
+* returns the instruction set of the selected kernel ("avx512", "avx2" or "scalar")
+*******************************************************************************/
+const char* GetDotKernelName() {
+	return SelectDotKernel().name;
+}
+
+/*******************************************************************************
+* GetNumParallelThreads()
+* returns the number of threads of an OpenMP parallel region started here
+*******************************************************************************/
+int GetNumParallelThreads() {
+#ifdef _OPENMP
+	return omp_in_parallel() ? 1 : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// =============================================================================
+// SIMD dot product of two contiguous double arrays, the implementation (AVX-512,
+// AVX2+FMA or scalar) is picked once at runtime from the host cpu
+// =============================================================================
+typedef double (*DotFunc)(const double* a, const double* b, int n);
+
+DotFunc GetDotKernel();
+const char* GetDotKernelName();
+
+// =============================================================================
+// OpenMP threads a parallel region started on the calling thread would get, 1
+// without OpenMP. A region on a single thread still allocates its team every
+// time it starts, so kernels that go parallel above some size check this too
+// =============================================================================
+int GetNumParallelThreads();
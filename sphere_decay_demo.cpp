@@ -90,10 +90,13 @@ int main(int argc, char* argv[]) {
 	col_2->SetColor(ChColor(0, 0, 0.6f));
 	body->AddAsset(col_2);
 
+	double timestep = 0.015; // also sets the timesteps in chrono system
 	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRadiationTimeStep(timestep); // resample the RIRF to the simulation step
 	my_hydro_inputs.SetRegularWaveAmplitude(0.022);
 	my_hydro_inputs.SetRegularWaveOmega(2.10);
 	LoadAllHydroForces blah(body, "../../HydroChrono/sphere.h5", "body1", my_hydro_inputs);
+	blah.GetHydroForces().PrintReport(std::cout);
 
 	// update irrlicht app with body info
 	application.AssetBindAll();
@@ -108,7 +111,6 @@ int main(int argc, char* argv[]) {
 	auto gmres_solver = chrono_types::make_shared<ChSolverGMRES>();  // change to mkl or minres?
 	gmres_solver->SetMaxIterations(300);
 	system.SetSolver(gmres_solver);
-	double timestep = 0.015; // also sets the timesteps in chrono system
 	application.SetTimestep(timestep);
 
 	// set up output file for body position each step
@@ -128,7 +130,7 @@ int main(int argc, char* argv[]) {
 		application.BeginScene();
 		application.DrawAll();
 		/*if (buttonPressed)*/if(true) {
-			zpos << system.GetChTime() << "\t" << body->GetPos().z() << "\t" << body->GetPos_dt().z() << "\t" << body->GetAppliedForce().z() << "\n";
+			zpos << system.GetChTime() << "\t" << body->GetPos().z() << "\t" << body->GetPos_dt().z() << "\t" << blah.GetForce()[2] << "\n";
 			application.DoStep();
 			frame++;
 		}
@@ -1,4 +1,5 @@
 #include "hydro_forces.h"
+#include "result_recorder.h"
 #include "chrono_irrlicht/ChIrrNodeAsset.h"
 #include <chrono>
 
@@ -23,41 +24,48 @@ int main(int argc, char* argv[]) {
 	col_2->SetColor(ChColor(0, 0, 0.6f));
 	body->AddAsset(col_2);
 
+	double timestep = 0.015; // also sets the timesteps in chrono system
 	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRadiationTimeStep(timestep); // resample the RIRF to the simulation step
 	my_hydro_inputs.SetRegularWaveAmplitude(0.022);
 	my_hydro_inputs.SetRegularWaveOmega(2.10);
+	// for large heave the hydrostatic force can be integrated over the sphere mesh instead of using the linear stiffness
+	//my_hydro_inputs.SetHydrostaticsMode(HydrostaticsMode::NONLINEAR);
+	//my_hydro_inputs.SetHydrostaticsMeshFiles({ "../../HydroChrono/meshFiles/oes_task10_sphere.obj" });
 	LoadAllHydroForces blah(body, "../../HydroChrono/sphere.h5", "body1", my_hydro_inputs);
+	blah.GetHydroForces().PrintReport(std::cout);
 
 	// Info about which solver to use - may want to change this later
 	auto gmres_solver = chrono_types::make_shared<ChSolverGMRES>();  // change to mkl or minres?
 	gmres_solver->SetMaxIterations(300);
 	system.SetSolver(gmres_solver);
-	double timestep = 0.015; // also sets the timesteps in chrono system
 	//system.SetTimestep(timestep);
 
-	// set up output file for body position each step
-	std::string of = "output.txt";                    /// < put name of your output file here
-	std::ofstream zpos(of, std::ofstream::out);
-	if (!zpos.is_open()) {
+	// set up output file for body position, velocity and hydro force each step
+	std::string of = "output.hcr";                    /// < put name of your output file here
+	ResultRecorder recorder(of, ResultRecorder::GetHydroColumnNames(1));
+	if (!recorder.IsOpen()) {
 		std::cout << "Error opening file \"" + of + "\". Please make sure this file path exists then try again\n";
 		return -1;
 	}
-	zpos.precision(10);
-	zpos.width(12);
-	zpos << "#Time\tBody Pos\tBody vel (heave)\tforce (heave)\n";
 
 	// Simulation loop
 	int frame = 0;
 	while (/*application.GetDevice()->run() && */system.GetChTime() <= 400) {
 		/*if (buttonPressed)*/if(true) {
-			zpos << system.GetChTime() << "\t" << body->GetPos().x() << "\t" << body->GetPos().z() << "\t" << body->GetPos_dt().z() << "\t" << body->GetAppliedForce().z() << "\n";
+			recorder.RecordHydro(blah.GetHydroForces());
 			system.DoStepDynamics(timestep);
 			frame++;
 		}
 	}
-	zpos.close();
+	if (!recorder.Close()) {
+		std::cout << "could not write all results to " << of << "\n";
+	}
 	auto end = std::chrono::high_resolution_clock::now();
 	unsigned duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 	std::cout << "Duration: " << duration/1000.0 << " seconds" << std::endl;
+	if (HydroForces::IsProfilingEnabled()) {
+		blah.GetHydroForces().PrintProfile(std::cout);
+	}
 	return 0;
 }
@@ -0,0 +1,128 @@
+#include "hydro_forces.h"
+#include "result_recorder.h"
+#include "checkpoint.h"
+#include "chrono_irrlicht/ChIrrNodeAsset.h"
+#include <filesystem>
+#include <chrono>
+#include <sstream>
+
+int main(int argc, char* argv[]) {
+	GetLog() << "Copyright (c) 2017 projectchrono.org\nChrono version: " << CHRONO_VERSION << "\n\n";
+	GetLog() << "HydroChrono v0.0.1\n\n";
+
+	// define some basic model parameters
+	auto start = std::chrono::high_resolution_clock::now();
+	ChSystemNSC system;
+	system.Set_G_acc(ChVector<>(0, 0, -9.81));
+
+	// Setup Ground
+	auto ground = chrono_types::make_shared<ChBody>();
+	system.AddBody(ground);
+	ground->SetPos(ChVector<>(0, 0, -5));
+	ground->SetIdentifier(-1);
+	ground->SetBodyFixed(true);
+	ground->SetCollide(false);
+
+	// create easy sphere
+	std::shared_ptr<ChBody> body = chrono_types::make_shared<ChBodyEasySphere>(5, 1);
+	auto sph = chrono_types::make_shared<ChSphereShape>();
+	body->AddAsset(sph);
+	system.Add(body);
+	// set up body initial conditions
+	body->SetPos(ChVector<>(0, 0, -2));
+	body->SetMass(261.8e3);
+	// attach color asset to body
+	auto col_2 = chrono_types::make_shared<ChColorAsset>();
+	col_2->SetColor(ChColor(0, 0, 0.6f));
+	body->AddAsset(col_2);
+
+	// set up output file for body position each step
+	std::string out_dir = "results/irregular_waves/";
+	std::cout << "creating results directory...\n";
+	std::filesystem::create_directories(out_dir);
+
+	// S = 0.0005
+	// Info about which solver to use - may want to change this later
+	auto gmres_solver = chrono_types::make_shared<ChSolverGMRES>();  // change to mkl or minres?
+	gmres_solver->SetMaxIterations(300);
+	system.SetSolver(gmres_solver);
+	double timestep = 0.015; // also sets the timesteps in chrono system
+
+	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRadiationTimeStep(timestep); // resample the RIRF to the simulation step
+	my_hydro_inputs.SetWaveMode(WaveMode::IRREGULAR);
+	my_hydro_inputs.SetIrregularWaveHeight(1.0);
+	my_hydro_inputs.SetIrregularWavePeakPeriod(8.0);
+	my_hydro_inputs.SetIrregularWaveGamma(3.3);
+	my_hydro_inputs.SetIrregularWaveNumComponents(1000);
+	my_hydro_inputs.SetIrregularWaveSeed(1);
+	// for long runs the whole excitation time series can be synthesized up front instead
+	//my_hydro_inputs.SetIrregularWavePrecompute(true);
+	//my_hydro_inputs.SetIrregularWaveTimeStep(timestep);
+	//my_hydro_inputs.SetIrregularWaveDuration(1000);
+	//my_hydro_inputs.SetIrregularWaveSeriesFile(out_dir + "excitation_series.bin");
+	LoadAllHydroForces blah(body, "../../HydroChrono/sphere.h5", "body1", my_hydro_inputs);
+	blah.GetHydroForces().PrintReport(std::cout);
+
+	// the hydro state and the sphere are checkpointed every 100 s, a preempted run continues with
+	//   sphere_irreg_waves_no_viz --restart results/irregular_waves/irregwave_seed1.chk
+	std::string run_name = "irregwave_seed" + std::to_string(my_hydro_inputs.GetIrregularWaveSeed());
+	std::string checkpoint_file = out_dir + run_name + ".chk";
+	bool restart = argc > 2 && std::string(argv[1]) == "--restart";
+	if (restart) {
+		std::string error;
+		if (!CheckpointWriter::Load(blah.GetHydroForces(), argv[2], true, &error)) {
+			std::cout << error << "\n";
+			return 1;
+		}
+		std::cout << "restored hydro state at t = " << system.GetChTime() << " s from " << argv[2] << "\n";
+	}
+	CheckpointWriter checkpoint;
+	double checkpoint_interval = 100;
+	double next_checkpoint = system.GetChTime() + checkpoint_interval;
+	bool checkpointing = true;
+
+	std::string out_file = run_name + (restart ? "_restart.hcr" : ".hcr");
+	std::ostringstream description;
+	description.precision(10);
+	description << "Significant wave height (m): " << my_hydro_inputs.GetIrregularWaveHeight() << "\n";
+	description << "Peak period (s): " << my_hydro_inputs.GetIrregularWavePeakPeriod() << "\n";
+	description << "Gamma: " << my_hydro_inputs.GetIrregularWaveGamma();
+	ResultRecorder recorder(out_dir + out_file, ResultRecorder::GetHydroColumnNames(1), 1, description.str());
+	if (!recorder.IsOpen()) {
+		std::cout << "Error opening file \"" + out_dir + out_file + "\". Please make sure this file path exists then try again\n";
+		return -1;
+	}
+
+	// Simulation loop
+	int frame = 0;
+	while (system.GetChTime() <= 1000) {
+		if (true) {
+			recorder.RecordHydro(blah.GetHydroForces());
+			system.DoStepDynamics(timestep);
+			frame++;
+			if (checkpointing && system.GetChTime() >= next_checkpoint) {
+				if (!checkpoint.Save(blah.GetHydroForces(), checkpoint_file)) {
+					// keep running without checkpoints, the results don't depend on them
+					std::cout << checkpoint.GetError() << "\n";
+					checkpointing = false;
+				}
+				next_checkpoint += checkpoint_interval;
+			}
+		}
+	}
+	if (!recorder.Close()) {
+		std::cout << "could not write all results to " << out_dir + out_file << "\n";
+	}
+	if (!checkpoint.Wait() && checkpointing) {
+		std::cout << checkpoint.GetError() << "\n";
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	unsigned duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	std::cout << "Duration: " << duration / 1000.0 << " seconds" << std::endl;
+	if (HydroForces::IsProfilingEnabled()) {
+		blah.GetHydroForces().PrintProfile(std::cout);
+	}
+
+	return 0;
+}
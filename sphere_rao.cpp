@@ -0,0 +1,64 @@
+#include "frequency_domain.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+// steady state response of the sphere_reg_waves_no_viz model solved in the
+// frequency domain, usage:
+//   sphere_rao [h5 file]
+// prints the heave amplitude and absorbed power of the Task 10 regular wave
+// cases (each with its own PTO damping) and writes the response of the sphere
+// without PTO at every frequency of the h5 file to results/sphere_rao.csv
+int main(int argc, char* argv[]) {
+	GetLog() << "Copyright (c) 2017 projectchrono.org\nChrono version: " << CHRONO_VERSION << "\n\n";
+	GetLog() << "HydroChrono v0.0.1\n\n";
+
+	std::string h5_file = argc > 1 ? argv[1] : "../../HydroChrono/sphere.h5";
+	double task10_wave_amps[] = { 0.044, 0.078, 0.095, 0.123, 0.177, 0.24, 0.314, 0.397, 0.491, 0.594 };
+	double task10_wave_omegas[] = { 2.094395102, 1.570796327, 1.427996661, 1.256637061, 1.047197551, 0.897597901, 0.785398163, 0.698131701, 0.628318531, 0.571198664 };
+	double task10dampings[] = { 398736.034, 118149.758, 90080.857, 161048.558, 322292.419, 479668.979, 633979.761, 784083.286, 932117.647, 1077123.445 };
+
+	auto start = std::chrono::high_resolution_clock::now();
+	FrequencyDomainSolver solver({ H5FileInfo::Load(h5_file, "body1") });
+	// same mass as sphere_reg_waves_no_viz, the inertia is that of ChBodyEasySphere(5, 1)
+	double inertia = 0.4 * (4.0 / 3.0 * 3.14159265358979323846 * 125.0) * 25.0;
+	solver.SetMass(0, 261.8e3, ChVector<>(inertia, inertia, inertia));
+	std::cout << solver.GetSetupMessages();
+
+	std::cout << "case  omega (rad/s)  wave amp (m)  heave amp (m)  heave phase (rad)  power (W)\n";
+	for (int i = 0; i < 10; i++) {
+		// PTO damper in heave between the sphere and the ground
+		solver.ClearPTO();
+		solver.AddPTO(2, -1, 0.0, task10dampings[i]);
+		FrequencyResponse response = solver.Solve({ task10_wave_omegas[i] });
+		std::complex<double> heave = response.GetRAO(0, 2) * task10_wave_amps[i];
+		std::printf("%4d  %13.6f  %12.3f  %13.6f  %17.6f  %9.1f\n", i + 1, task10_wave_omegas[i], task10_wave_amps[i], std::abs(heave), std::arg(heave),
+			response.power[0] * task10_wave_amps[i] * task10_wave_amps[i]);
+	}
+
+	solver.ClearPTO();
+	FrequencyResponse response = solver.Solve();
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "solved " << response.omega.size() + 10 << " frequencies in "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0 << " ms\n";
+
+	std::string out_dir = "results/";
+	std::filesystem::create_directories(out_dir);
+	std::FILE* csv = std::fopen((out_dir + "sphere_rao.csv").c_str(), "w");
+	if (csv == nullptr) {
+		std::cout << "could not create " << out_dir << "sphere_rao.csv\n";
+		return 1;
+	}
+	std::fprintf(csv, "omega,surge_amp,surge_phase,heave_amp,heave_phase,pitch_amp,pitch_phase\n");
+	for (size_t f = 0; f < response.omega.size(); f++) {
+		std::fprintf(csv, "%.17g", response.omega[f]);
+		for (int dof : { 0, 2, 4 }) {
+			std::complex<double> rao = response.GetRAO((int)f, dof);
+			std::fprintf(csv, ",%.17g,%.17g", std::abs(rao), std::arg(rao));
+		}
+		std::fprintf(csv, "\n");
+	}
+	std::fclose(csv);
+	std::cout << "wrote " << out_dir << "sphere_rao.csv\n";
+	return 0;
+}
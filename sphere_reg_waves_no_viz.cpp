@@ -1,7 +1,9 @@
 #include "hydro_forces.h"
+#include "result_recorder.h"
 #include "chrono_irrlicht/ChIrrNodeAsset.h"
 #include <filesystem>
 #include <chrono>
+#include <sstream>
 
 int main(int argc, char* argv[]) {
 	GetLog() << "Copyright (c) 2017 projectchrono.org\nChrono version: " << CHRONO_VERSION << "\n\n";
@@ -65,35 +67,46 @@ int main(int argc, char* argv[]) {
 	system.AddLink(spring_1);
 
 	HydroInputs my_hydro_inputs;
+	my_hydro_inputs.SetRadiationTimeStep(timestep); // resample the RIRF to the simulation step
 	my_hydro_inputs.SetRegularWaveAmplitude(task10_wave_amps[reg_wave_num - 1]); //0.095;
 	my_hydro_inputs.SetRegularWaveOmega(task10_wave_omegas[reg_wave_num - 1]); //1.427996661;
 	//my_hydro_inputs.regular_wave_amplitude = task10_wave_amps[reg_wave_num-1]; //0.095;
 	//my_hydro_inputs.regular_wave_omega = task10_wave_omegas[reg_wave_num-1];//1.427996661;
+	// switch the wave on smoothly over a few periods instead of at once
+	//my_hydro_inputs.SetExcitationRampTime(5 * 2 * 3.14159265358979323846 / my_hydro_inputs.GetRegularWaveOmega());
 	LoadAllHydroForces blah(body, "../../HydroChrono/sphere.h5", "body1", my_hydro_inputs);
+	blah.GetHydroForces().PrintReport(std::cout);
 
-	std::string out_file = "regwave_" + std::to_string(reg_wave_num) + ".txt";
-	std::ofstream out_stream(out_dir + out_file, std::ofstream::out);
-
-	out_stream.precision(10);
-	out_stream.width(12);
-	out_stream << "Wave #: \t" << reg_wave_num << "\n";
-	out_stream << "Wave amplitude (m): \t" << my_hydro_inputs.GetRegularWaveAmplitude() << "\n";
-	out_stream << "Wave omega (rad/s): \t" << my_hydro_inputs.GetRegularWaveOmega() << "\n";
-	out_stream << "#Time\tBody Pos\tBody vel (heave)\tforce (heave)\n";
+	std::string out_file = "regwave_" + std::to_string(reg_wave_num) + ".hcr";
+	std::ostringstream description;
+	description.precision(10);
+	description << "Wave #: " << reg_wave_num << "\n";
+	description << "Wave amplitude (m): " << my_hydro_inputs.GetRegularWaveAmplitude() << "\n";
+	description << "Wave omega (rad/s): " << my_hydro_inputs.GetRegularWaveOmega();
+	ResultRecorder recorder(out_dir + out_file, ResultRecorder::GetHydroColumnNames(1), 1, description.str());
+	if (!recorder.IsOpen()) {
+		std::cout << "Error opening file \"" + out_dir + out_file + "\". Please make sure this file path exists then try again\n";
+		return -1;
+	}
 
 	// Simulation loop
 	int frame = 0;
 	while (system.GetChTime() <= 400) {
 		if (true) {
-			out_stream << system.GetChTime() << "\t" << body->GetPos().x() << "\t" << body->GetPos().z() << "\t" << body->GetPos_dt().z() << "\t" << body->GetAppliedForce().z() << "\n";
+			recorder.RecordHydro(blah.GetHydroForces());
 			system.DoStepDynamics(timestep);
 			frame++;
 		}
 	}
-	out_stream.close();
+	if (!recorder.Close()) {
+		std::cout << "could not write all results to " << out_dir + out_file << "\n";
+	}
 	auto end = std::chrono::high_resolution_clock::now();
 	unsigned duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 	std::cout << "Duration: " << duration / 1000.0 << " seconds" << std::endl;
+	if (HydroForces::IsProfilingEnabled()) {
+		blah.GetHydroForces().PrintProfile(std::cout);
+	}
 
 	return 0;
 }
@@ -0,0 +1,78 @@
+#include "sweep_runner.h"
+#include <algorithm>
+#include <chrono>
+
+// runs the Task 10 regular wave cases (or the cases of a case file) of
+// sphere_reg_waves_no_viz in parallel, usage:
+//   sphere_reg_waves_sweep [--verify] [--warm-start] [h5 file] [case file] [number of threads]
+// a case file has one "amplitude omega pto_damping" line per case. --verify
+// also runs every case serially and fails unless both runs match bitwise.
+// --warm-start starts every case from its linear steady state and only runs
+// ten periods of the longest wave instead of 400 s
+int main(int argc, char* argv[]) {
+	GetLog() << "Copyright (c) 2017 projectchrono.org\nChrono version: " << CHRONO_VERSION << "\n\n";
+	GetLog() << "HydroChrono v0.0.1\n\n";
+
+	bool verify = false;
+	bool warm_start = false;
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--verify") {
+			verify = true;
+		}
+		else if (std::string(argv[i]) == "--warm-start") {
+			warm_start = true;
+		}
+		else {
+			args.push_back(argv[i]);
+		}
+	}
+
+	std::string h5_file = args.size() > 0 ? args[0] : "../../HydroChrono/sphere.h5";
+	std::vector<SweepCase> cases;
+	if (args.size() > 1) {
+		std::string error;
+		cases = SweepRunner::ReadCases(args[1], &error);
+		std::cout << error;
+	}
+	else {
+		double task10_wave_amps[] = { 0.044, 0.078, 0.095, 0.123, 0.177, 0.24, 0.314, 0.397, 0.491, 0.594 };
+		double task10_wave_omegas[] = { 2.094395102, 1.570796327, 1.427996661, 1.256637061, 1.047197551, 0.897597901, 0.785398163, 0.698131701, 0.628318531, 0.571198664 };
+		double task10dampings[] = { 398736.034, 118149.758, 90080.857, 161048.558, 322292.419, 479668.979, 633979.761, 784083.286, 932117.647, 1077123.445 };
+		for (int i = 0; i < 10; i++) {
+			cases.push_back({ task10_wave_amps[i], task10_wave_omegas[i], task10dampings[i] });
+		}
+	}
+	if (cases.empty()) {
+		std::cout << "no cases to run\n";
+		return 1;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	SweepRunner sweep(h5_file, "results/regular_waves_sweep");
+	if (args.size() > 2) {
+		sweep.SetNumThreads(atoi(args[2].c_str()));
+	}
+	if (warm_start) {
+		double omega_min = cases[0].omega;
+		for (const SweepCase& sweep_case : cases) {
+			omega_min = std::min(omega_min, sweep_case.omega);
+		}
+		sweep.SetWarmStart(true);
+		sweep.SetEndTime(10 * 2 * 3.14159265358979323846 / omega_min);
+	}
+	if (verify) {
+		return sweep.Verify(cases) ? 0 : 1;
+	}
+	std::vector<SweepResult> results = sweep.Run(cases);
+	auto end = std::chrono::high_resolution_clock::now();
+	unsigned duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	std::cout << "Duration: " << duration / 1000.0 << " seconds" << std::endl;
+
+	for (const SweepResult& result : results) {
+		if (!result.ok) {
+			return 1;
+		}
+	}
+	return 0;
+}
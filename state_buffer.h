@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// =============================================================================
+// StateWriter, StateReader
+// flat native endian byte buffer the force models save their time stepping
+// state to (SaveState()) and restore it from (RestoreState()), see
+// CheckpointWriter. Arrays are stored with their length, and an array is only
+// read back into storage of exactly that length, so a checkpoint of a
+// different model setup fails to restore instead of resizing anything.
+// A cleared StateWriter keeps its capacity, saving the same state again does
+// not allocate.
+// =============================================================================
+class StateWriter {
+public:
+	void Clear() { buffer.clear(); }
+	template <typename T> void Write(const T& val) {
+		static_assert(std::is_trivially_copyable<T>::value, "StateWriter only writes plain values");
+		Append(&val, sizeof(T));
+	}
+	template <typename T> void WriteArray(const T* vals, size_t count) {
+		static_assert(std::is_trivially_copyable<T>::value, "StateWriter only writes plain values");
+		Write((uint64_t)count);
+		Append(vals, sizeof(T) * count);
+	}
+	template <typename T> void Write(const std::vector<T>& vals) { WriteArray(vals.data(), vals.size()); }
+	const char* GetData() const { return buffer.data(); }
+	size_t GetSize() const { return buffer.size(); }
+private:
+	void Append(const void* data, size_t bytes) {
+		const char* begin = (const char*)data;
+		buffer.insert(buffer.end(), begin, begin + bytes);
+	}
+	std::vector<char> buffer;
+};
+
+class StateReader {
+public:
+	StateReader(const char* data, size_t size) : next(data), end(data + size), ok(true) {}
+	template <typename T> bool Read(T& val) {
+		static_assert(std::is_trivially_copyable<T>::value, "StateReader only reads plain values");
+		return Take(&val, sizeof(T));
+	}
+	template <typename T> bool ReadArray(T* vals, size_t count) {
+		static_assert(std::is_trivially_copyable<T>::value, "StateReader only reads plain values");
+		uint64_t stored = 0;
+		if (!Read(stored) || stored != count) {
+			ok = false;
+			return false;
+		}
+		return Take(vals, sizeof(T) * count);
+	}
+	template <typename T> bool Read(std::vector<T>& vals) { return ReadArray(vals.data(), vals.size()); }
+	bool IsOk() const { return ok; }
+	bool IsAtEnd() const { return ok && next == end; }
+private:
+	bool Take(void* data, size_t bytes) {
+		if (!ok || (size_t)(end - next) < bytes) {
+			ok = false;
+			return false;
+		}
+		if (bytes > 0) {
+			std::memcpy(data, next, bytes);
+		}
+		next += bytes;
+		return true;
+	}
+	const char* next;
+	const char* end;
+	bool ok;
+};
@@ -0,0 +1,285 @@
+#include "sweep_runner.h"
+#include "result_recorder.h"
+#include "frequency_domain.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+	/*******************************************************************************
+	* SerialOpenMPScope
+	* sets the calling thread's OpenMP thread count to 1 and restores the
+	* previous count when it goes out of scope
+	*******************************************************************************/
+	class SerialOpenMPScope {
+	public:
+#ifdef _OPENMP
+		SerialOpenMPScope() : saved_threads(omp_get_max_threads()) { omp_set_num_threads(1); }
+		~SerialOpenMPScope() { omp_set_num_threads(saved_threads); }
+	private:
+		int saved_threads;
+#endif
+	};
+}
+
+// =============================================================================
+// SweepRunner Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* SweepRunner constructor
+* h5_file is the sphere's hydro data, one result file per case is written to
+* out_dir (created if needed). Defaults match sphere_reg_waves_no_viz
+*******************************************************************************/
+SweepRunner::SweepRunner(std::string h5_file, std::string out_dir_name)
+	: h5_file_name(h5_file), out_dir(out_dir_name), timestep(0.015), end_time(400), num_threads(0), warm_start(false) {}
+
+/*******************************************************************************
+* SweepRunner::ReadCases()
+* reads a case table, one case per line as "amplitude omega pto_damping",
+* blank lines and lines starting with # are skipped. If the file can't be
+* opened or has malformed lines *error (if error isn't null) says so, one
+* line per problem, the malformed lines are skipped
+*******************************************************************************/
+std::vector<SweepCase> SweepRunner::ReadCases(std::string file, std::string* error) {
+	std::vector<SweepCase> cases;
+	std::ostringstream problems;
+	std::ifstream stream(file);
+	if (!stream.is_open()) {
+		if (error != nullptr) {
+			*error = "could not open case file " + file + "\n";
+		}
+		return cases;
+	}
+	std::string line;
+	while (std::getline(stream, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream fields(line);
+		SweepCase sweep_case;
+		if (fields >> sweep_case.amplitude >> sweep_case.omega >> sweep_case.pto_damping) {
+			cases.push_back(sweep_case);
+		}
+		else {
+			problems << "skipping malformed case line: " << line << "\n";
+		}
+	}
+	if (error != nullptr) {
+		*error = problems.str();
+	}
+	return cases;
+}
+
+/*******************************************************************************
+* SweepRunner::RunCase()
+* builds and runs one case on the calling thread, writing
+* out_dir/regwave_<case_number>.hcr in the sphere_reg_waves_no_viz format,
+* from rest or (warm start) from the case's linear steady state.
+* If history isn't null it also gets time, surge, heave, heave velocity and
+* heave force of every step. Exceptions of the hydro force stack (bad h5
+* file, inputs or series file) fail the case with their message as error
+*******************************************************************************/
+SweepResult SweepRunner::RunCase(int case_number, const SweepCase& sweep_case, std::vector<double>* history) const {
+	auto start = std::chrono::high_resolution_clock::now();
+	SweepResult result;
+	result.ok = false;
+	result.num_steps = 0;
+	result.duration = 0;
+	result.file_name = out_dir + "/regwave_" + std::to_string(case_number) + ".hcr";
+
+	// thrown on a worker thread it would end the whole sweep, the case fails instead
+	try {
+		// the workers already use every core, keep each system and its hydro forces on its own thread,
+		// the calling thread is one of the workers and gets its thread count back afterwards
+		SerialOpenMPScope serial_openmp;
+		ChSystemNSC system;
+		system.SetNumThreads(1);
+		system.Set_G_acc(ChVector<>(0, 0, -9.81));
+
+		auto ground = chrono_types::make_shared<ChBody>();
+		system.AddBody(ground);
+		ground->SetPos(ChVector<>(0, 0, -5));
+		ground->SetIdentifier(-1);
+		ground->SetBodyFixed(true);
+		ground->SetCollide(false);
+
+		std::shared_ptr<ChBody> body = chrono_types::make_shared<ChBodyEasySphere>(5, 1);
+		system.Add(body);
+		body->SetPos(ChVector<>(0, 0, -2));
+		body->SetMass(261.8e3);
+
+		auto gmres_solver = chrono_types::make_shared<ChSolverGMRES>();
+		gmres_solver->SetMaxIterations(300);
+		system.SetSolver(gmres_solver);
+
+		// PTO, linear damper between the sphere and ground
+		auto spring_1 = chrono_types::make_shared<ChLinkTSDA>();
+		spring_1->Initialize(body, ground, true, ChVector<>(0, 0, -2), ChVector<>(0, 0, -5));
+		spring_1->SetRestLength(3.0);
+		spring_1->SetSpringCoefficient(0.0);
+		spring_1->SetDampingCoefficient(sweep_case.pto_damping);
+		system.AddLink(spring_1);
+
+		HydroInputs my_hydro_inputs;
+		my_hydro_inputs.SetRegularWaveAmplitude(sweep_case.amplitude);
+		my_hydro_inputs.SetRegularWaveOmega(sweep_case.omega);
+		my_hydro_inputs.SetRadiationTimeStep(timestep);
+		LoadAllHydroForces blah(body, h5_file_name, "body1", my_hydro_inputs);
+		if (warm_start) {
+			// the same sphere and PTO as a linear model, solved at the wave frequency
+			FrequencyDomainSolver linear_model({ H5FileInfo::Load(h5_file_name, "body1") });
+			linear_model.SetMass(0, body->GetMass(), body->GetInertiaXX());
+			linear_model.AddPTO(2, -1, 0.0, sweep_case.pto_damping);
+			if (!blah.GetHydroForces().WarmStart(linear_model)) {
+				// running from rest would need the full end time, not the warm start's
+				result.error = "warm start failed";
+				return result;
+			}
+		}
+
+		std::ostringstream description;
+		description.precision(10);
+		description << "Wave #: " << case_number << "\n";
+		description << "Wave amplitude (m): " << my_hydro_inputs.GetRegularWaveAmplitude() << "\n";
+		description << "Wave omega (rad/s): " << my_hydro_inputs.GetRegularWaveOmega() << "\n";
+		description << "PTO damping (N s/m): " << sweep_case.pto_damping;
+		ResultRecorder recorder(result.file_name, ResultRecorder::GetHydroColumnNames(1), 1, description.str());
+		if (!recorder.IsOpen()) {
+			result.error = "writing results failed";
+			return result;
+		}
+
+		while (system.GetChTime() <= end_time) {
+			recorder.RecordHydro(blah.GetHydroForces());
+			if (history != nullptr) {
+				history->insert(history->end(), { system.GetChTime(), body->GetPos().x(), body->GetPos().z(), body->GetPos_dt().z(), blah.GetForce()[2] });
+			}
+			system.DoStepDynamics(timestep);
+			result.num_steps++;
+		}
+		result.ok = recorder.Close();
+		if (!result.ok) {
+			result.error = "writing results failed";
+		}
+	}
+	catch (const std::exception& e) {
+		result.error = e.what();
+		return result;
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.duration = std::chrono::duration<double>(end - start).count();
+	return result;
+}
+
+/*******************************************************************************
+* SweepRunner::GetNumWorkers()
+* num_threads (or the number of hardware threads), at most one per case
+*******************************************************************************/
+int SweepRunner::GetNumWorkers(size_t num_cases) const {
+	int workers = num_threads > 0 ? num_threads : (int)std::max(1u, std::thread::hardware_concurrency());
+	return std::max(1, std::min(workers, (int)num_cases));
+}
+
+/*******************************************************************************
+* SweepRunner::RunCases()
+* runs all cases on workers threads (the calling thread is one of them), each
+* worker takes the next case not yet started until none are left. Case i (from
+* 0) writes regwave_<i+1>.hcr, results are returned in case order. If
+* histories isn't null (*histories)[i] gets case i's history (see RunCase()).
+* If the hydro data can't be loaded every case fails with that error
+*******************************************************************************/
+std::vector<SweepResult> SweepRunner::RunCases(const std::vector<SweepCase>& cases, int workers, std::vector<std::vector<double>>* histories) const {
+	std::vector<SweepResult> results(cases.size());
+	if (cases.empty()) {
+		return results;
+	}
+	std::error_code error;
+	std::filesystem::create_directories(out_dir, error);
+	// read the hydro data once up front, every case then shares it through the cache
+	try {
+		H5FileInfo::Load(h5_file_name, "body1");
+	}
+	catch (const std::exception& e) {
+		for (SweepResult& result : results) {
+			result.ok = false;
+			result.error = e.what();
+			result.num_steps = 0;
+			result.duration = 0;
+		}
+		std::cout << "could not load " << h5_file_name << ": " << e.what() << "\n";
+		return results;
+	}
+	if (histories != nullptr) {
+		histories->assign(cases.size(), std::vector<double>());
+	}
+	std::cout << "running " << cases.size() << " cases on " << workers << " threads\n";
+
+	std::atomic<int> next_case(0);
+	std::mutex print_mutex;
+	auto worker = [&]() {
+		for (int i = next_case++; i < (int)cases.size(); i = next_case++) {
+			results[i] = RunCase(i + 1, cases[i], histories != nullptr ? &(*histories)[i] : nullptr);
+			std::lock_guard<std::mutex> lock(print_mutex);
+			std::cout << "case " << i + 1 << ": " << results[i].num_steps << " steps in " << results[i].duration << " seconds"
+				<< (results[i].ok ? "" : ", " + results[i].error) << "\n";
+		}
+	};
+	std::vector<std::thread> threads;
+	for (int t = 1; t < workers; t++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	return results;
+}
+
+/*******************************************************************************
+* SweepRunner::Run()
+* runs all cases in parallel, see RunCases()
+*******************************************************************************/
+std::vector<SweepResult> SweepRunner::Run(const std::vector<SweepCase>& cases) const {
+	return RunCases(cases, GetNumWorkers(cases.size()), nullptr);
+}
+
+/*******************************************************************************
+* SweepRunner::Verify()
+* runs all cases in parallel and then serially on the calling thread, and
+* compares the two runs of every case bit for bit. Concurrent systems only
+* agree with serial ones if the hydro force stack keeps no shared mutable state
+* returns true if every case ran and matches
+*******************************************************************************/
+bool SweepRunner::Verify(const std::vector<SweepCase>& cases) const {
+	std::vector<std::vector<double>> parallel_histories;
+	std::vector<std::vector<double>> serial_histories;
+	std::vector<SweepResult> parallel_results = RunCases(cases, std::max(2, GetNumWorkers(cases.size())), &parallel_histories);
+	std::vector<SweepResult> serial_results = RunCases(cases, 1, &serial_histories);
+	bool match = true;
+	for (size_t i = 0; i < cases.size(); i++) {
+		if (!parallel_results[i].ok || !serial_results[i].ok) {
+			// a case that failed before stepping has nothing to compare
+			match = false;
+			continue;
+		}
+		const std::vector<double>& par = parallel_histories[i];
+		const std::vector<double>& ser = serial_histories[i];
+		if (par.size() != ser.size() || (!par.empty() && std::memcmp(par.data(), ser.data(), sizeof(double) * par.size()) != 0)) {
+			std::cout << "case " << i + 1 << ": parallel and serial results differ\n";
+			match = false;
+		}
+	}
+	std::cout << (match ? "all cases identical in parallel and serial runs\n" : "parallel and serial runs differ\n");
+	return match;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "hydro_forces.h"
+
+// =============================================================================
+// SweepRunner
+// runs a table of regular wave cases of the heaving sphere with a linear PTO
+// damper (the sphere_reg_waves_no_viz model) concurrently on a pool of worker
+// threads. Every case gets its own ChSystem, bodies and HydroForces, built and
+// stepped entirely on the worker that picked it, so workers share nothing but
+// the read only hydro data from H5FileInfo::Load(), which is read once before
+// the workers start. Each case writes its own result file.
+// With warm start every case starts from the linear frequency domain steady
+// state of its wave and PTO (see HydroForces::WarmStart()) instead of from
+// rest, so a much shorter end time is enough.
+// Verify() runs the cases on the workers and again one after another and
+// checks that both give bitwise identical time histories.
+// =============================================================================
+struct SweepCase {
+	double amplitude;     ///< regular wave amplitude, m
+	double omega;         ///< regular wave frequency, rad/s
+	double pto_damping;   ///< damping coefficient of the PTO between sphere and ground, N s/m
+};
+
+struct SweepResult {
+	bool ok;              ///< false if the warm start failed or the result file couldn't be written
+	std::string error;    ///< why the case failed, empty if ok
+	int num_steps;
+	double duration;      ///< wall clock time of the case, s
+	std::string file_name;
+};
+
+class SweepRunner {
+public:
+	SweepRunner(std::string h5_file, std::string out_dir);
+	double SetTimeStep(double val) {
+		timestep = val;
+		return timestep;
+	}
+	double GetTimeStep() const { return timestep; }
+	double SetEndTime(double val) {
+		end_time = val;
+		return end_time;
+	}
+	double GetEndTime() const { return end_time; }
+	int SetNumThreads(int val) {
+		num_threads = val;
+		return num_threads;
+	}
+	int GetNumThreads() const { return num_threads; }
+	bool SetWarmStart(bool val) {
+		warm_start = val;
+		return warm_start;
+	}
+	bool GetWarmStart() const { return warm_start; }
+	std::vector<SweepResult> Run(const std::vector<SweepCase>& cases) const;
+	bool Verify(const std::vector<SweepCase>& cases) const;
+	SweepResult RunCase(int case_number, const SweepCase& sweep_case, std::vector<double>* history = nullptr) const;
+	static std::vector<SweepCase> ReadCases(std::string file, std::string* error = nullptr);
+private:
+	std::vector<SweepResult> RunCases(const std::vector<SweepCase>& cases, int workers, std::vector<std::vector<double>>* histories) const;
+	int GetNumWorkers(size_t num_cases) const;
+	std::string h5_file_name;
+	std::string out_dir;
+	double timestep;
+	double end_time;
+	int num_threads;      ///< 0 uses one worker per hardware thread
+	bool warm_start;      ///< start every case from its linear steady state
+};
@@ -0,0 +1,234 @@
+#include "wave_excitation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// =============================================================================
+// Wave Spectrum Definitions
+// =============================================================================
+
+/*******************************************************************************
+* JonswapSpectrum()
+* one sided JONSWAP wave spectral density S(omega) (m^2 s/rad) for significant
+* wave height hs (m), peak period tp (s) and peak enhancement factor gamma, in
+* the DNV-RP-C205 form. gamma = 1 gives the Pierson-Moskowitz spectrum
+*******************************************************************************/
+double JonswapSpectrum(double omega, double hs, double tp, double gamma) {
+	if (omega <= 0.0 || tp <= 0.0) {
+		return 0.0;
+	}
+	const double pi = 3.14159265358979323846;
+	double omega_p = 2.0 * pi / tp;
+	double ratio = omega_p / omega;
+	double s_pm = 5.0 / 16.0 * hs * hs * pow(omega_p, 4) * pow(omega, -5) * exp(-1.25 * pow(ratio, 4));
+	if (gamma == 1.0) {
+		return s_pm;
+	}
+	double sigma = omega <= omega_p ? 0.07 : 0.09;
+	double shape = (omega - omega_p) / (sigma * omega_p);
+	double normalization = 1.0 - 0.287 * log(gamma);
+	return normalization * s_pm * pow(gamma, exp(-0.5 * shape * shape));
+}
+
+/*******************************************************************************
+* MakeJonswapComponents()
+* splits [omega_min, omega_max] into num_components equal bands, each band is
+* one component at its center frequency with amplitude sqrt(2 S(omega) d_omega)
+* and a uniformly distributed random phase. The same seed gives the same sea
+*******************************************************************************/
+WaveComponents MakeJonswapComponents(double hs, double tp, double gamma, double omega_min, double omega_max, int num_components, unsigned int seed) {
+	const double pi = 3.14159265358979323846;
+	WaveComponents components;
+	if (num_components <= 0 || omega_max <= omega_min) {
+		return components;
+	}
+	components.omega.resize(num_components);
+	components.amplitude.resize(num_components);
+	components.phase.resize(num_components);
+	double d_omega = (omega_max - omega_min) / num_components;
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> phase_distribution(0.0, 2.0 * pi);
+	for (int k = 0; k < num_components; k++) {
+		double w = omega_min + (k + 0.5) * d_omega;
+		components.omega[k] = w;
+		components.amplitude[k] = sqrt(2.0 * JonswapSpectrum(w, hs, tp, gamma) * d_omega);
+		components.phase[k] = phase_distribution(generator);
+	}
+	return components;
+}
+
+/*******************************************************************************
+* MakeJonswapComponentsOnGrid()
+* one component at every multiple of d_omega in [omega_min, omega_max], with
+* amplitude sqrt(2 S(omega) d_omega) and a uniformly distributed random phase.
+* With d_omega = 2 pi / (n dt) the components are the bins of an n point FFT
+* on a dt time grid (see ExcitationTimeSeries)
+*******************************************************************************/
+WaveComponents MakeJonswapComponentsOnGrid(double hs, double tp, double gamma, double omega_min, double omega_max, double d_omega, unsigned int seed) {
+	const double pi = 3.14159265358979323846;
+	WaveComponents components;
+	if (d_omega <= 0.0 || omega_max < omega_min) {
+		return components;
+	}
+	int first = std::max(1, (int)ceil(omega_min / d_omega));
+	int last = (int)floor(omega_max / d_omega);
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> phase_distribution(0.0, 2.0 * pi);
+	for (int m = first; m <= last; m++) {
+		double w = m * d_omega;
+		components.omega.push_back(w);
+		components.amplitude.push_back(sqrt(2.0 * JonswapSpectrum(w, hs, tp, gamma) * d_omega));
+		components.phase.push_back(phase_distribution(generator));
+	}
+	return components;
+}
+
+// =============================================================================
+// IrregularWaveExcitation Class Definitions
+// =============================================================================
+
+/*******************************************************************************
+* IrregularWaveExcitation default constructor
+* no components, Compute() gives zero force
+*******************************************************************************/
+IrregularWaveExcitation::IrregularWaveExcitation()
+	: num_dofs(0), num_components(0), phasor_time(0), step_dt(0), has_phasors(false), steps_since_sync(0), dot(GetDotKernel()) {}
+
+/*******************************************************************************
+* IrregularWaveExcitation constructor
+* omegas are the component frequencies, coefficients_re/_im the complex force
+* amplitude of each component on each DOF ([dof][component]), that is the wave
+* amplitude times the excitation coefficient X_j(w_k) times e^(i phi_k).
+* Only DOFs with a nonzero coefficient are kept
+*******************************************************************************/
+IrregularWaveExcitation::IrregularWaveExcitation(int dofs, const std::vector<double>& omegas, const std::vector<double>& coefficients_re, const std::vector<double>& coefficients_im)
+	: IrregularWaveExcitation() {
+	num_dofs = dofs;
+	num_components = (int)omegas.size();
+	omega = omegas;
+	for (int j = 0; j < num_dofs; j++) {
+		auto begin_re = coefficients_re.begin() + (size_t)j * num_components;
+		auto begin_im = coefficients_im.begin() + (size_t)j * num_components;
+		auto nonzero = [](double val) { return val != 0.0; };
+		if (std::any_of(begin_re, begin_re + num_components, nonzero) || std::any_of(begin_im, begin_im + num_components, nonzero)) {
+			active_dofs.push_back(j);
+			coef_re.insert(coef_re.end(), begin_re, begin_re + num_components);
+			coef_im.insert(coef_im.end(), begin_im, begin_im + num_components);
+		}
+	}
+	phasor_re.resize(num_components);
+	phasor_im.resize(num_components);
+	step_re.resize(num_components);
+	step_im.resize(num_components);
+}
+
+/*******************************************************************************
+* IrregularWaveExcitation::Synchronize()
+* sets the phasors to e^(i w_k time) directly
+*******************************************************************************/
+void IrregularWaveExcitation::Synchronize(double time) {
+	for (int k = 0; k < num_components; k++) {
+		phasor_re[k] = cos(omega[k] * time);
+		phasor_im[k] = sin(omega[k] * time);
+	}
+	phasor_time = time;
+	has_phasors = true;
+	steps_since_sync = 0;
+}
+
+/*******************************************************************************
+* IrregularWaveExcitation::Rotate()
+* advances the phasors by step_dt, one complex multiply per component
+*******************************************************************************/
+void IrregularWaveExcitation::Rotate() {
+	for (int k = 0; k < num_components; k++) {
+		double re = phasor_re[k] * step_re[k] - phasor_im[k] * step_im[k];
+		double im = phasor_re[k] * step_im[k] + phasor_im[k] * step_re[k];
+		phasor_re[k] = re;
+		phasor_im[k] = im;
+	}
+	phasor_time += step_dt;
+	steps_since_sync++;
+}
+
+/*******************************************************************************
+* IrregularWaveExcitation::Compute()
+* writes the excitation force at time of every DOF to force[0 .. dofs-1].
+* Repeated calls at the same time reuse the phasors, a step equal to the
+* previous one is one rotation, any other step (first call, variable time
+* step, going back in time) recomputes the phasors and the step rotation
+*******************************************************************************/
+void IrregularWaveExcitation::Compute(double time, double* force) {
+	if (!has_phasors) {
+		Synchronize(time);
+	}
+	else if (time != phasor_time) {
+		double dt = time - phasor_time;
+		if (fabs(dt - step_dt) > 1e-9 * fabs(step_dt)) {
+			step_dt = dt;
+			for (int k = 0; k < num_components; k++) {
+				step_re[k] = cos(omega[k] * dt);
+				step_im[k] = sin(omega[k] * dt);
+			}
+			Synchronize(time);
+		}
+		else if (steps_since_sync >= kResyncInterval) {
+			Synchronize(time);
+		}
+		else {
+			Rotate();
+			// the accumulated time may be off from time by round off
+			phasor_time = time;
+		}
+	}
+	// F_j = Re(sum_k c_jk e^(i w_k t)) = c_re . cos(w t) - c_im . sin(w t),
+	// DOFs are independent and spread over OpenMP threads for large farms,
+	// small ones stay out of the OpenMP runtime (see RadiationConvolution::Compute())
+	int num_active = (int)active_dofs.size();
+	if (num_active < num_dofs) {
+		std::fill(force, force + num_dofs, 0.0);
+	}
+	auto compute_dof = [&](int a) {
+		const double* c_re = &coef_re[(size_t)a * num_components];
+		const double* c_im = &coef_im[(size_t)a * num_components];
+		force[active_dofs[a]] = dot(c_re, phasor_re.data(), num_components) - dot(c_im, phasor_im.data(), num_components);
+	};
+	if ((long long)num_active * num_components >= kParallelMinWork && GetNumParallelThreads() > 1) {
+		#pragma omp parallel for schedule(dynamic, 6)
+		for (int a = 0; a < num_active; a++) {
+			compute_dof(a);
+		}
+		return;
+	}
+	for (int a = 0; a < num_active; a++) {
+		compute_dof(a);
+	}
+}
+
+/*******************************************************************************
+* IrregularWaveExcitation::SaveState()
+* appends the phasors, the step rotation and the steps since the last
+* resynchronization to out, the rotation recurrence continues from them
+* exactly where it left off
+*******************************************************************************/
+void IrregularWaveExcitation::SaveState(StateWriter& out) const {
+	out.Write(has_phasors);
+	out.Write(phasor_time);
+	out.Write(step_dt);
+	out.Write(steps_since_sync);
+	out.Write(phasor_re);
+	out.Write(phasor_im);
+	out.Write(step_re);
+	out.Write(step_im);
+}
+
+/*******************************************************************************
+* IrregularWaveExcitation::RestoreState()
+* reads back what SaveState() wrote, the number of components must match
+* returns false if it doesn't
+*******************************************************************************/
+bool IrregularWaveExcitation::RestoreState(StateReader& in) {
+	return in.Read(has_phasors) && in.Read(phasor_time) && in.Read(step_dt) && in.Read(steps_since_sync) && in.Read(phasor_re) && in.Read(phasor_im)
+		&& in.Read(step_re) && in.Read(step_im);
+}
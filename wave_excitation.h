@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "simd_kernels.h"
+#include "state_buffer.h"
+
+// =============================================================================
+// wave spectrum discretization
+// =============================================================================
+struct WaveComponents {
+	std::vector<double> omega;      ///< component frequencies, rad/s
+	std::vector<double> amplitude;  ///< component wave amplitudes, m
+	std::vector<double> phase;      ///< component random phases, rad
+};
+
+double JonswapSpectrum(double omega, double hs, double tp, double gamma);
+WaveComponents MakeJonswapComponents(double hs, double tp, double gamma, double omega_min, double omega_max, int num_components, unsigned int seed);
+WaveComponents MakeJonswapComponentsOnGrid(double hs, double tp, double gamma, double omega_min, double omega_max, double d_omega, unsigned int seed);
+
+// =============================================================================
+// IrregularWaveExcitation
+// evaluates the excitation force of a sum of wave components
+//   F_j(t) = sum_k a_k |X_j(w_k)| cos(w_k t + phi_k + angle(X_j(w_k)))
+// for every DOF j. The per component coefficients a_k X_j(w_k) e^(i phi_k) are
+// built once at construction ([dof][component], real and imaginary parts in
+// separate arrays), each step only advances the unit phasors e^(i w_k t) by one
+// complex multiply (rotation recurrence) and takes two SIMD dot products per DOF,
+// with the DOFs split over OpenMP threads once dofs * components is large.
+// DOFs whose coefficients are all zero (no excitation in the h5 file) are not
+// stored and get zero force without a dot product.
+// The phasors are recomputed with cos/sin when the time step changes and every
+// kResyncInterval steps to stop round off from building up.
+// No heap allocation happens after construction.
+// =============================================================================
+class IrregularWaveExcitation {
+public:
+	IrregularWaveExcitation();
+	IrregularWaveExcitation(int dofs, const std::vector<double>& omegas, const std::vector<double>& coefficients_re, const std::vector<double>& coefficients_im);
+	void Compute(double time, double* force);
+	void SaveState(StateWriter& out) const;
+	bool RestoreState(StateReader& in);
+	int GetNumDofs() const { return num_dofs; }
+	int GetNumComponents() const { return num_components; }
+	int GetNumActiveDofs() const { return (int)active_dofs.size(); }
+	size_t GetNumBytes() const { return sizeof(double) * (coef_re.size() + coef_im.size() + 5 * (size_t)num_components) + sizeof(int) * active_dofs.size(); }
+private:
+	void Synchronize(double time);
+	void Rotate();
+	static const int kResyncInterval = 256;
+	static const long long kParallelMinWork = 1 << 18; ///< smallest dofs * components run in parallel
+	int num_dofs;
+	int num_components;
+	std::vector<double> omega;           ///< [component]
+	std::vector<int> active_dofs;        ///< DOFs with any nonzero coefficient
+	std::vector<double> coef_re;         ///< [active dof][component], Re(a_k X_j(w_k) e^(i phi_k))
+	std::vector<double> coef_im;         ///< [active dof][component], Im(a_k X_j(w_k) e^(i phi_k))
+	std::vector<double> phasor_re;       ///< [component], cos(w_k phasor_time)
+	std::vector<double> phasor_im;       ///< [component], sin(w_k phasor_time)
+	std::vector<double> step_re;         ///< [component], cos(w_k step_dt)
+	std::vector<double> step_im;         ///< [component], sin(w_k step_dt)
+	double phasor_time;                  ///< time the phasors were last advanced to
+	double step_dt;                      ///< time step step_re, step_im rotate by
+	bool has_phasors;
+	int steps_since_sync;
+	DotFunc dot;
+};